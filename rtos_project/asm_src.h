@@ -27,4 +27,8 @@ extern void restoreRegs();
 extern void* storeRegs();
 extern void setExecpLr();
 extern uint32_t reg0();
+extern uint32_t getBasepri(void);
+extern void setBasepri(uint32_t basepri);
+extern void raiseBasepri(uint32_t basepri);
+extern uint32_t getIpsr(void);
 #endif
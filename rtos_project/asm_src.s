@@ -27,6 +27,10 @@
    .def storeRegs
    .def setExecpLr
    .def reg0
+   .def getBasepri
+   .def setBasepri
+   .def raiseBasepri
+   .def getIpsr
 
 ;-----------------------------------------------------------------------------
 ; Register values and large immediate values
@@ -133,3 +137,21 @@ setExecpLr:
 
 reg0:
 	BX LR
+
+getBasepri:
+	MRS R0, BASEPRI			; current interrupt mask priority, 0 masks nothing
+	BX LR
+
+setBasepri:
+	MSR BASEPRI, R0			; restores a mask saved by getBasepri
+	ISB
+	BX LR
+
+raiseBasepri:
+	MSR BASEPRI_MAX, R0		; only writes if it raises the mask, never lowers it
+	ISB
+	BX LR
+
+getIpsr:
+	MRS R0, IPSR				; active exception number, 0 in thread mode
+	BX LR
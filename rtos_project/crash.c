@@ -0,0 +1,197 @@
+// Crash record functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "crash.h"
+#include "kdata.h"
+#include "uart0.h"
+#include "c_fnc.h"
+#include "heapplan.h"
+
+// the target keeps the record in a NOINIT section, the host simulation has no
+// reset to survive, so it stands in with a file read at init and written on
+// save, tools/mmhost round trips it
+#ifdef HOST_SIM
+#include <stdio.h>
+CRASH_RECORD crashRecord;
+#else
+// placed at CRASH_ADDRESS by the linker command file, see .crash
+#pragma DATA_SECTION(crashRecord, ".crash")
+CRASH_RECORD crashRecord;
+#endif
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// a missing or short file leaves no magic, so the record reads as empty
+void crashLoad(void)
+{
+#ifdef HOST_SIM
+    FILE* f = fopen(CRASH_FILE, "rb");
+    bool ok = false;
+    if (f)
+    {
+        ok = fread(&crashRecord, sizeof(crashRecord), 1, f) == 1;
+        fclose(f);
+    }
+    if (!ok)
+        crashRecord.magic = 0;
+#endif
+}
+
+// a file that was not written whole is removed rather than left half old
+void crashStore(void)
+{
+#ifdef HOST_SIM
+    FILE* f = fopen(CRASH_FILE, "wb");
+    bool ok = false;
+    if (f)
+    {
+        ok = fwrite(&crashRecord, sizeof(crashRecord), 1, f) == 1;
+        ok &= fclose(f) == 0;
+    }
+    if (!ok)
+        remove(CRASH_FILE);
+#endif
+}
+
+uint32_t crashCheck(void)
+{
+    uint32_t* p = &crashRecord.count;
+    uint32_t words = (sizeof(CRASH_RECORD) - 8) / 4;
+    uint32_t sum = 0;
+    while (words--)
+        sum += *p++;
+    return sum;
+}
+
+bool crashValid(void)
+{
+    return (crashRecord.magic == CRASH_MAGIC) && (crashRecord.check == crashCheck());
+}
+
+// power on leaves random contents, the check tells them from a real record
+void initCrash(void)
+{
+    char str[12];
+    crashLoad();
+    if (!crashValid())
+    {
+        crashClear();
+        return;
+    }
+    putsUart0("crash record from before reset, ");
+    putsUart0(numToStr(crashRecord.count, str));
+    putsUart0(" fault(s), see 'crash'\n");
+}
+
+// sp range is checked against sram, a kernel fault may have a wild sp
+void crashSave(FAULT_RECORD* fault, char name[], uint32_t sp)
+{
+    uint8_t i;
+    uint32_t count = crashValid() ? crashRecord.count : 0;
+    crashRecord.magic = 0;                  // invalid until the check is written
+    crashRecord.count = count + 1;
+    crashRecord.reserved = 0;
+    crashRecord.tick = kdata.tick;
+    crashRecord.fault = *fault;
+    for (i = 0; i < sizeof(crashRecord.name) - 1 && name[i]; i++)
+        crashRecord.name[i] = name[i];
+    for (; i < sizeof(crashRecord.name); i++)
+        crashRecord.name[i] = 0;
+    crashRecord.traceCount = traceLast(crashRecord.trace, CRASH_TRACE_EVENTS);
+    sp &= ~3;
+    crashRecord.sp = sp;
+    for (i = 0; i < CRASH_STACK_WORDS; i++)
+    {
+        uint32_t address = sp + i * 4;
+        crashRecord.stack[i] = (address >= SRAM_ADDRESS && address < SRAM_END) ? *(uint32_t*)address : 0;
+    }
+    crashRecord.check = crashCheck();
+    crashRecord.magic = CRASH_MAGIC;
+    crashStore();
+}
+
+void crashClear(void)
+{
+    uint32_t* p = (uint32_t*)&crashRecord;
+    uint32_t words = sizeof(CRASH_RECORD) / 4;
+    while (words--)
+        *p++ = 0;
+    crashStore();
+}
+
+void printHexWord(uint32_t value)
+{
+    char str[12];
+    putcUart0(' ');
+    putsUart0(uint32ToHexString(&value, str));
+}
+
+// line tagged, tools/crashdecode.py decodes a captured dump
+//   T type task tickHi tickLo count name
+//   F cfsr hfsr address psp
+//   R r0 r1 r2 r3 r12 lr pc xpsr
+//   E cycles info             trace events, oldest first
+//   S address value           stack snapshot
+//   B address                 backtrace, innermost first
+void crashShow(void)
+{
+    uint8_t i;
+    if (!crashValid())
+    {
+        putsUart0("#crash empty\n");
+        return;
+    }
+    putsUart0("#crash begin\nT");
+    printHexWord(crashRecord.fault.type);
+    printHexWord(crashRecord.fault.task);
+    printHexWord((uint32_t)(crashRecord.tick >> 32));
+    printHexWord((uint32_t)crashRecord.tick);
+    printHexWord(crashRecord.count);
+    putcUart0(' ');
+    putsUart0(crashRecord.name);
+    putsUart0("\nF");
+    printHexWord(crashRecord.fault.cfsr);
+    printHexWord(crashRecord.fault.hfsr);
+    printHexWord(crashRecord.fault.address);
+    printHexWord(crashRecord.fault.psp);
+    putsUart0("\nR");
+    for (i = 0; i < 8; i++)
+        printHexWord(crashRecord.fault.regs[i]);
+    putcUart0('\n');
+    for (i = 0; i < crashRecord.traceCount; i++)
+    {
+        putcUart0('E');
+        printHexWord(crashRecord.trace[i].cycles);
+        printHexWord(crashRecord.trace[i].info);
+        putcUart0('\n');
+    }
+    for (i = 0; i < CRASH_STACK_WORDS; i++)
+    {
+        putcUart0('S');
+        printHexWord(crashRecord.sp + i * 4);
+        printHexWord(crashRecord.stack[i]);
+        putcUart0('\n');
+    }
+    for (i = 0; i < crashRecord.fault.depth; i++)
+    {
+        putcUart0('B');
+        printHexWord(crashRecord.fault.backtrace[i]);
+        putcUart0('\n');
+    }
+    putsUart0("#crash end\n");
+}
@@ -0,0 +1,66 @@
+// Crash record functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef CRASH_H_
+#define CRASH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "faults.h"
+#include "trace.h"
+
+//-----------------------------------------------------------------------------
+// Crash record
+//-----------------------------------------------------------------------------
+
+// 256 B below the kdata page, not zeroed by the C startup so the last fault
+// survives a reset (not a power cycle), kernel only, no MPU window for tasks
+#define CRASH_ADDRESS 0x20000E00
+#define CRASH_SIZE    256
+#define CRASH_MAGIC   0x43525348       // "CRSH"
+
+// file the host simulation keeps the record in between runs
+#if defined(HOST_SIM) && !defined(CRASH_FILE)
+#define CRASH_FILE "crash.bin"
+#endif
+
+#define CRASH_TRACE_EVENTS 8           // newest trace events, if trace ever ran
+#define CRASH_STACK_WORDS  12          // words from the faulting sp up
+
+// shell commands, passed in r0 of the crash svc
+#define CRASH_SHOW  0
+#define CRASH_CLEAR 1
+
+typedef struct _CRASH_RECORD
+{
+    uint32_t magic;
+    uint32_t check;                // sum of the words from count to the end
+    uint32_t count;                // faults recorded since the record was cleared
+    uint32_t reserved;
+    uint64_t tick;                 // kdata tick at the fault
+    FAULT_RECORD fault;
+    char name[16];                 // task name, "kernel" if not in a task
+    uint32_t sp;                   // address of stack[0]
+    uint32_t traceCount;
+    TRACE_EVENT trace[CRASH_TRACE_EVENTS];
+    uint32_t stack[CRASH_STACK_WORDS];
+} CRASH_RECORD;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// kernel side, privileged only
+void initCrash(void);
+void crashSave(FAULT_RECORD* fault, char name[], uint32_t sp);
+void crashShow(void);
+void crashClear(void);
+
+#endif
@@ -0,0 +1,36 @@
+// DWT cycle counter functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef DWT_H_
+#define DWT_H_
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+// Core debug and DWT registers (not in tm4c123gh6pm.h)
+//-----------------------------------------------------------------------------
+
+#define CORE_DEMCR_R            (*((volatile uint32_t *)0xE000EDFC))
+#define CORE_DEMCR_TRCENA       0x01000000  // enables DWT and ITM blocks
+
+#define DWT_CTRL_R              (*((volatile uint32_t *)0xE0001000))
+#define DWT_CTRL_CYCCNTENA      0x00000001  // cycle counter enable
+#define DWT_CYCCNT_R            (*((volatile uint32_t *)0xE0001004))
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// counter runs at the 40 MHz core clock and wraps every ~107 s, so only
+// differences of 32 bit reads are meaningful, privileged access only
+// safe to call more than once, the count is left running
+void initCycleCounter(void);
+
+#endif
@@ -18,6 +18,11 @@
 #include "c_fnc.h"
 #include "asm_src.h"
 #include "uart0.h"
+#include "kernel.h"
+#include "crash.h"
+#include "unwind.h"
+
+extern uint32_t __STACK_TOP;    // top of the kernel stack, from the linker command file
 
 //-----------------------------------------------------------------------------
 // Subroutines
@@ -26,26 +31,43 @@
 // REQUIRED: If these were written in assembly
 //           omit this file and add a faults.s file
 
-// REQUIRED: code this function
-void mpuFaultIsr(void)
+FAULT_RECORD lastFault;
+char* faultName[] = {"MPU", "Hard", "Bus", "Usage"};
+
+// common path for all faults, prints the stacked frame, then if a task was
+// running (thread mode, nothing else active) the frame is recorded and the
+// kernel kills the task in pendsv, a fault inside the kernel or an isr can't
+// be undone and halts
+void faultHandler(uint8_t type, uint32_t address)
 {
     uint32_t psp = getPsp();    // top of exception entry - regs stacked on PSP
     uint32_t msp = getMsp();    // MSP
-    uint32_t mFaultStat = (NVIC_FAULT_STAT_R) & 0xFF;   // if MPU fault, flag describes the type
+    uint32_t cfsr = NVIC_FAULT_STAT_R;  // mpu, bus and usage fault flags
+    uint32_t hfsr = NVIC_HFAULT_STAT_R;
     uint32_t regData[8];        // holds xPSR, PC, LR, R12, R0-3 (respect to 7..0 index)
+    uint8_t task = MAX_TASKS;
+    uint8_t i;
     getStackDump(regData, psp); // get registers data from exception entry
-    uint32_t mfaultDataAdds = NVIC_MM_ADDR_R;
+    if (NVIC_INT_CTRL_R & NVIC_INT_CTRL_RET_BASE)
+        task = taskOfStack(psp);
+
     // Print all the data
     char buffer[9];
-    putsUart0("\nMPU fault in process N\n");
-    putsUart0("Fault Instruction Address:\t0x");    putsUart0(uint32ToHexString(&regData[6], buffer));
-    putsUart0("\nFault Data Address:\t0x");    putsUart0(uint32ToHexString(&mfaultDataAdds, buffer));
     putcUart0('\n');
+    putsUart0(faultName[type]); putsUart0(" fault in ");
+    putsUart0((task < MAX_TASKS) ? taskNameOf(task) : "kernel"); putcUart0('\n');
+    if (address)
+    {
+        putsUart0("Fault Data Address:\t0x");    putsUart0(uint32ToHexString(&address, buffer));
+        putcUart0('\n');
+    }
     putsUart0("PSP:\t0x");      putsUart0(uint32ToHexString(&psp, buffer));
     putcUart0('\n');
     putsUart0("MSP:\t0x");      putsUart0(uint32ToHexString(&msp, buffer));
     putcUart0('\n');
-    putsUart0("mfault:\t0x");   putsUart0(uint32ToHexString(&mFaultStat, buffer));
+    putsUart0("CFSR:\t0x");     putsUart0(uint32ToHexString(&cfsr, buffer));
+    putcUart0('\n');
+    putsUart0("HFSR:\t0x");     putsUart0(uint32ToHexString(&hfsr, buffer));
     putcUart0('\n');
     putsUart0("R0:\t0x");       putsUart0(uint32ToHexString(&regData[0], buffer));
     putcUart0('\n');
@@ -64,70 +86,72 @@ void mpuFaultIsr(void)
     putsUart0("xPSR:\t0x");     putsUart0(uint32ToHexString(&regData[7], buffer));
     putcUart0('\n');
 
+    // a task's frame sits on its psp, the scan starts above it, a kernel
+    // fault has no frame at a known place, so only the handler stack is scanned
+    if (task < MAX_TASKS)
+        lastFault.depth = unwindStack(regData[6], regData[5], psp + 32, taskStackTop(task), lastFault.backtrace, UNWIND_DEPTH);
+    else
+        lastFault.depth = unwindStack(0, 0, msp, (uint32_t)&__STACK_TOP, lastFault.backtrace, UNWIND_DEPTH);
+    putsUart0("Backtrace, tools/crashdecode.py symbolizes:\n");
+    for (i = 0; i < lastFault.depth; i++)
+    {
+        putsUart0("B 0x");      putsUart0(uint32ToHexString(&lastFault.backtrace[i], buffer));
+        putcUart0('\n');
+    }
+
+    // W1C the flags just read, so the next fault reports only its own
+    NVIC_FAULT_STAT_R = cfsr;
+    NVIC_HFAULT_STAT_R = hfsr;
+
+    lastFault.type = type;
+    lastFault.task = task;
+    lastFault.cfsr = cfsr;
+    lastFault.hfsr = hfsr;
+    lastFault.address = address;
+    lastFault.psp = psp;
+    for (i = 0; i < 8; i++)
+        lastFault.regs[i] = regData[i];
+    // kept across reset, a kernel fault snapshots the handler stack instead
+    if (task < MAX_TASKS)
+        crashSave(&lastFault, taskNameOf(task), psp);
+    else
+        crashSave(&lastFault, "kernel", msp);
+
+    if (task == MAX_TASKS)
+        while(1){}
+    killFaultingTask(task);     // pendsv tail chains before the task could resume
+}
+
+// REQUIRED: code this function
+void mpuFaultIsr(void)
+{
+    // a stacking error leaves MMFAR invalid, but psp then already points
+    // into the guard subregion
+    uint32_t address = (NVIC_FAULT_STAT_R & NVIC_FAULT_STAT_MMARV) ? NVIC_MM_ADDR_R : 0;
+    faultHandler(FAULT_MPU, address);
     // turn off MPU pending bit
     NVIC_SYS_HND_CTRL_R &= ~(NVIC_SYS_HND_CTRL_MEMP);
-    // sets pendSV pending state
-    NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;
 }
 
 // REQUIRED: code this function
 void hardFaultIsr(void)
 {
-    uint32_t psp = getPsp();    // top of exception entry - regs stacked on PSP
-    uint32_t msp = getMsp();    // MSP
-    uint32_t mFaultStat = (NVIC_FAULT_STAT_R) & 0xFF;   // if MPU fault, flag describes the type
-    uint32_t regData[8];        // holds xPSR, PC, LR, R12, R0-3 (respect to 7..0 index)
-    getStackDump(regData, psp); // get registers data from exception entry
-
-    // Print all the data
-    char buffer[9];
-    putsUart0("\nHard fault in process pid\n");
-    putsUart0("Offending Address:\t0x");    putsUart0(uint32ToHexString(&regData[6], buffer));
-    putcUart0('\n');
-    putsUart0("PSP:\t0x");      putsUart0(uint32ToHexString(&psp, buffer));
-    putcUart0('\n');
-    putsUart0("MSP:\t0x");      putsUart0(uint32ToHexString(&msp, buffer));
-    putcUart0('\n');
-    putsUart0("mfault:\t0x");   putsUart0(uint32ToHexString(&mFaultStat, buffer));
-    putcUart0('\n');
-    putsUart0("R0:\t0x");       putsUart0(uint32ToHexString(&regData[0], buffer));
-    putcUart0('\n');
-    putsUart0("R1:\t0x");       putsUart0(uint32ToHexString(&regData[1], buffer));
-    putcUart0('\n');
-    putsUart0("R2:\t0x");       putsUart0(uint32ToHexString(&regData[2], buffer));
-    putcUart0('\n');
-    putsUart0("R3:\t0x");       putsUart0(uint32ToHexString(&regData[3], buffer));
-    putcUart0('\n');
-    putsUart0("R12:\t0x");      putsUart0(uint32ToHexString(&regData[4], buffer));
-    putcUart0('\n');
-    putsUart0("LR:\t0x");       putsUart0(uint32ToHexString(&regData[5], buffer));
-    putcUart0('\n');
-    putsUart0("PC:\t0x");       putsUart0(uint32ToHexString(&regData[6], buffer));
-    putcUart0('\n');
-    putsUart0("xPSR:\t0x");     putsUart0(uint32ToHexString(&regData[7], buffer));
-    putcUart0('\n');
-    // turn off bus pending bit
-    NVIC_SYS_HND_CTRL_R &= ~NVIC_SYS_HND_CTRL_BUSP;
-    // turn on bus fault
-    NVIC_SYS_HND_CTRL_R |= NVIC_SYS_HND_CTRL_BUS;
-    while(1){}
+    faultHandler(FAULT_HARD, 0);
 }
 
 // REQUIRED: code this function
 void busFaultIsr(void)
 {
-    putsUart0("\nBus fault in process pid\n");
+    uint32_t address = (NVIC_FAULT_STAT_R & NVIC_FAULT_STAT_BFARV) ? NVIC_FAULT_ADDR_R : 0;
+    faultHandler(FAULT_BUS, address);
     // turn off bus pending bit
     NVIC_SYS_HND_CTRL_R &= ~NVIC_SYS_HND_CTRL_BUSP;
-    while(1){}
 }
 
 // REQUIRED: code this function
 void usageFaultIsr(void)
 {
-    putsUart0("\nUsage fault in process pid\n");
+    faultHandler(FAULT_USAGE, 0);
     // turn off usage pending bit
     NVIC_SYS_HND_CTRL_R &= ~NVIC_SYS_HND_CTRL_USAGEP;
-    while(1){}
 }
-
@@ -11,10 +11,38 @@
 #ifndef FAULTS_H_
 #define FAULTS_H_
 
+#include <stdint.h>
+#include "unwind.h"
+
+// fault types, index into faultName
+#define FAULT_MPU   0
+#define FAULT_HARD  1
+#define FAULT_BUS   2
+#define FAULT_USAGE 3
+
+// frame of the last fault taken by a task
+typedef struct _FAULT_RECORD
+{
+    uint8_t  type;                 // see FAULT_ values above
+    uint8_t  task;                 // tcb index of the faulting task
+    uint8_t  depth;                // entries in backtrace
+    uint8_t  reserved;
+    uint32_t cfsr;                 // NVIC_FAULT_STAT_R at the fault
+    uint32_t hfsr;                 // NVIC_HFAULT_STAT_R at the fault
+    uint32_t address;              // MMFAR or BFAR, 0 if not valid
+    uint32_t psp;
+    uint32_t regs[8];              // R0-3, R12, LR, PC, xPSR as stacked
+    uint32_t backtrace[UNWIND_DEPTH];  // pc, lr, then return addresses found on the stack
+} FAULT_RECORD;
+
+extern FAULT_RECORD lastFault;
+extern char* faultName[];
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
+void faultHandler(uint8_t type, uint32_t address);
 void mpuFaultIsr(void);
 void hardFaultIsr(void);
 void busFaultIsr(void);
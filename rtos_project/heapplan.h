@@ -0,0 +1,30 @@
+// Heap region plan
+// generated by tools/heapplan.py from tm4c123gh6pm.cmd, do not edit
+
+#ifndef HEAPPLAN_H_
+#define HEAPPLAN_H_
+
+#define SRAM_ADDRESS 0x20000000
+#define SRAM_END 0x20008000
+#define PSTACK_ADDRESS 0x20001000
+#define HEAP_ADDRESS 0x20001000
+#define HEAP_SIZE 28672
+#define HEAP_END (HEAP_ADDRESS + HEAP_SIZE)
+
+// base, size, subregion size, MPU region, srd bit of subregion 0
+#define NUM_HEAP_REGIONS 5
+#define HEAP_REGION_LIST \
+{ \
+    {0x20001000,   4096,   512, 3,  8}, \
+    {0x20002000,   4096,   512, 4, 16}, \
+    {0x20003000,   4096,   512, 5, 24}, \
+    {0x20004000,   8192,  1024, 6, 32}, \
+    {0x20006000,   8192,  1024, 7, 40}, \
+}
+
+// distinct subregion sizes, smallest first, 40 subregions in all, the most
+// allocations and tasks a plan can hold whatever the SRAM size
+#define NUM_SUBREGION_SIZES 2
+#define SUBREGION_SIZE_LIST {512, 1024}
+
+#endif
@@ -0,0 +1,129 @@
+// Kernel data page functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "kdata.h"
+
+// placed at KDATA_ADDRESS by the linker command file, see .kdata
+#pragma DATA_SECTION(kdata, ".kdata")
+KDATA kdata;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// .kdata is not zeroed by the C startup, so clear it before startRtos
+void initKdata(void)
+{
+    uint8_t i;
+    kdata.seq = 0;
+    kdata.taskCurrent = 0;
+    kdata.taskCount = 0;
+    kdata.tick = 0;
+    for (i = 0; i < LOAD_WINDOWS; i++)
+        kdata.load[i] = 0;
+    for (i = 0; i < MAX_TASKS; i++)
+    {
+        kdata.task[i].pid = 0;
+        kdata.task[i].dispatches = 0;
+        kdata.task[i].ticks = 0;
+        kdata.task[i].subheap = 0;
+    }
+}
+
+// writers run in systick, pendsv and svc which do not preempt each other
+void kdataWriteBegin(void)
+{
+    kdata.seq++;                    // odd, readers will retry
+    __asm(" DMB");
+}
+
+void kdataWriteEnd(void)
+{
+    __asm(" DMB");
+    kdata.seq++;                    // even, page consistent again
+}
+
+// returns sequence value to compare against once the read is done
+static uint32_t kdataReadBegin(void)
+{
+    uint32_t seq;
+    do
+    {
+        seq = kdata.seq;
+    } while (seq & 1);              // kernel in the middle of an update
+    __asm(" DMB");
+    return seq;
+}
+
+static bool kdataReadRetry(uint32_t seq)
+{
+    __asm(" DMB");
+    return (kdata.seq != seq);
+}
+
+uint64_t getTickCount(void)
+{
+    uint32_t seq;
+    uint64_t tick;
+    do
+    {
+        seq = kdataReadBegin();
+        tick = kdata.tick;          // 64 bit read is two loads, so needs the seqlock
+    } while (kdataReadRetry(seq));
+    return tick;
+}
+
+uint8_t getTaskCurrent(void)
+{
+    return kdata.taskCurrent;
+}
+
+void* getCurrentPid(void)
+{
+    uint32_t seq;
+    void* pid;
+    do
+    {
+        seq = kdataReadBegin();
+        pid = kdata.task[kdata.taskCurrent].pid;
+    } while (kdataReadRetry(seq));
+    return pid;
+}
+
+void getSystemLoad(uint16_t load[LOAD_WINDOWS])
+{
+    uint32_t seq;
+    uint8_t i;
+    do
+    {
+        seq = kdataReadBegin();
+        for (i = 0; i < LOAD_WINDOWS; i++)
+            load[i] = kdata.load[i];
+    } while (kdataReadRetry(seq));
+}
+
+bool getTaskStats(uint8_t task, KDATA_TASK* stats)
+{
+    uint32_t seq;
+    if (task >= MAX_TASKS)
+        return false;
+    do
+    {
+        seq = kdataReadBegin();
+        *stats = kdata.task[task];
+    } while (kdataReadRetry(seq));
+    return (stats->pid != 0);
+}
@@ -0,0 +1,67 @@
+// Kernel data page functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef KDATA_H_
+#define KDATA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "kernel.h"
+
+//-----------------------------------------------------------------------------
+// Kernel data page
+//-----------------------------------------------------------------------------
+
+// 256 B page at the top of the kernel 4KB, MPU region 2 makes it read-only for
+// user tasks, so they can poll time and stats without a service call
+#define KDATA_ADDRESS 0x20000F00
+#define KDATA_SIZE    256
+
+// per task counters, index matches the tcb index
+typedef struct _KDATA_TASK
+{
+    void*    pid;                  // task fn address, 0 if slot is unused
+    uint32_t dispatches;           // times the task was switched in
+    uint32_t ticks;                // systick ticks the task was running on
+    void*    subheap;              // task's small object heap, 0 until first use
+} KDATA_TASK;
+
+// seqlock: seq is odd while the kernel is writing, readers retry on change
+typedef struct _KDATA
+{
+    volatile uint32_t seq;
+    uint8_t  taskCurrent;          // index of running task
+    uint8_t  taskCount;            // total number of valid tasks
+    uint16_t reserved;
+    uint64_t tick;                 // 1ms ticks since initRtos
+    uint16_t load[LOAD_WINDOWS];   // system cpu load, 1, 10, 60 s, idle excluded
+    uint16_t reserved2;
+    KDATA_TASK task[MAX_TASKS];
+} KDATA;
+
+extern KDATA kdata;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// kernel side, privileged only
+void initKdata(void);
+void kdataWriteBegin(void);
+void kdataWriteEnd(void);
+
+// user side, read only
+uint64_t getTickCount(void);
+uint8_t getTaskCurrent(void);
+void* getCurrentPid(void);
+void getSystemLoad(uint16_t load[LOAD_WINDOWS]);
+bool getTaskStats(uint8_t task, KDATA_TASK* stats);
+
+#endif
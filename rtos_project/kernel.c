@@ -22,6 +22,20 @@
 #include "asm_src.h"
 #include "c_fnc.h"
 #include "shell.h"
+#include "kdata.h"
+#include "ringbuf.h"
+#include "latency.h"
+#include "vtable.h"
+#include "workq.h"
+#include "dwt.h"
+#include "trace.h"
+#include "prof.h"
+#include "faults.h"
+#include "crash.h"
+#include "subheap.h"
+#include "pool.h"
+#include "share.h"
+#include "tasks.h"
 
 //-----------------------------------------------------------------------------
 // RTOS Defines and Kernel Variables
@@ -46,6 +60,25 @@ typedef struct _semaphore
 } semaphore;
 semaphore semaphores[MAX_SEMAPHORES];
 
+// event flag group
+typedef struct _flagGroup
+{
+    uint32_t flags;
+    uint8_t queueSize;
+    uint8_t processQueue[MAX_FLAG_QUEUE_SIZE];
+} flagGroup;
+flagGroup flagGroups[MAX_FLAG_GROUPS];
+
+// message queue
+typedef struct _queue
+{
+    RING ring;
+    uint8_t queueSize;
+    uint8_t processQueue[MAX_QUEUE_WAIT_SIZE];
+} queue;
+queue queues[MAX_QUEUES];
+uint32_t queueStorage[MAX_QUEUES][MAX_QUEUE_RECORDS];
+
 // Service Call (SVC) types
 #define START   0                 // starts the first task
 #define YIELD   1                 // sets pendSV to switch task if any ready
@@ -68,6 +101,32 @@ semaphore semaphores[MAX_SEMAPHORES];
 #define NAME_R  18                // reset a task by name
 #define SET_PRI 19                // changes priority of a task
 #define PS      20                // stores ps data
+#define SETFLAGS 21               // sets event flags of a group
+#define WAITFLAGS 22              // waits for any flag in mask
+#define NOTIFY  23                // sets notification bits of a task
+#define NOTIFY_WAIT 24            // waits for notification bits
+#define Q_SEND  25                // sends message to a queue
+#define Q_RECV  26                // receives message from a queue
+#define LATENCY 27                // starts, stops, prints or resets the interrupt latency test
+#define IRQSTAT 28                // prints or resets per vector isr counts and cycles
+#define WORK_FETCH 29             // copies a batch of deferred work to the worker
+#define TRACE   30                // starts, stops or dumps the event trace
+#define PROF    31                // starts, stops or reports the pc sampling profiler
+#define AUTORESTART 32            // restarts tasks killed by a fault
+#define CRASH   33                // shows or clears the crash record kept across reset
+#define SUBHEAP_INIT 34           // reserves the calling task's small object heap
+#define POOL_CREATE 35            // carves a fixed block pool from the caller's heap
+#define POOL_ALLOC 36             // takes a block from a pool
+#define POOL_FREE 37              // gives a block back to its pool
+#define FREE    38                // frees an allocation of the calling task
+#define REALLOC 39                // resizes an allocation of the calling task
+#define SHARE_CREATE 40           // allocates a named region for sharing
+#define SHARE_GRANT 41            // grants or revokes another task's access to a share
+#define SHARE_OPEN 42             // looks up a share granted to the calling task
+#define MALLOC_WAIT 43            // allocates, blocking until memory is freed or the timeout
+#define MEM_PRESSURE 44           // registers the caller's reclaim bits and oom exemption
+#define OOM     45                // sets the out of memory policy
+#define SHARE_DESTROY 46          // revokes every grant of a share and frees it
 
 // task states
 #define STATE_INVALID           0 // no task
@@ -76,6 +135,10 @@ semaphore semaphores[MAX_SEMAPHORES];
 #define STATE_DELAYED           3 // has run, but now awaiting timer
 #define STATE_BLOCKED_MUTEX     4 // has run, but now blocked by semaphore
 #define STATE_BLOCKED_SEMAPHORE 5 // has run, but now blocked by semaphore
+#define STATE_BLOCKED_FLAGS     6 // has run, but now waiting event flags
+#define STATE_BLOCKED_NOTIFY    7 // has run, but now waiting notification
+#define STATE_BLOCKED_QUEUE     8 // has run, but now waiting queue message
+#define STATE_BLOCKED_MEMORY    9 // has run, but now waiting heap memory
 
 // task
 uint8_t taskCurrent = 0;          // index of last dispatched task
@@ -87,6 +150,8 @@ bool priorityInheritance = false; // priority inheritance for mutexes
 bool preemption = true;           // preemption (true) or cooperative (false)
 
 // tcb
+// the records are a kernel owned heap allocation made by initRtos, the kernel
+// 4KB has no room left for them, no task window ever covers it
 #define NUM_PRIORITIES   16
 struct _tcb
 {
@@ -97,24 +162,95 @@ struct _tcb
     uint8_t priority;              // 0=highest
     uint8_t currentPriority;       // 0=highest (needed for pi)
     uint32_t size;                 // size of the task stack
-    uint32_t ticks;                // ticks until sleep complete
-    uint32_t clockA;               // time the task takes of CPU (CPU use) buffer A, wr when pingpong 0 else rd
-    uint32_t clockB;               // time the task takes of CPU (CPU use) buffer B, wr when pingpong 1 else rd
+    uint16_t guard;                // no access bytes below the stack, 0 if unguarded
+    uint32_t stackBytes;           // createThread request, STACK_GUARD included, for restarts
+    uint32_t ticks;                // ticks until sleep or memory wait complete
+    uint64_t cycles;               // total clocks the task has run, from DWT_CYCCNT
+    uint32_t epoch;                // epoch epochCycles belongs to, folded lazily
+    uint32_t epochCycles;          // clocks run in that epoch
+    uint16_t load[LOAD_WINDOWS];   // 1, 10, 60 s averages, LOAD_FIXED_1 = 100%
+    uint32_t stackFree;            // words above the stack base still holding STACK_PAINT
+    uint32_t stackScan;            // next word the idle time scan checks
     uint64_t srd;                  // MPU subregion disable bits
     char name[16];                 // name of task used in ps command
     uint8_t mutex;                 // index of the mutex in use or blocking the thread
     uint8_t semaphore;             // index of the semaphore that is blocking the thread
-} tcb[MAX_TASKS];
+    uint32_t flagMask;             // event flags the thread is waiting for
+    uint32_t memRequest;           // bytes the thread is waiting for in STATE_BLOCKED_MEMORY
+    uint32_t notifyValue;          // pending notification bits
+    uint32_t retValue;             // R0 for a blocking svc, see setTaskReturn
+    bool retPending;
+    bool memWaited;                // a whole tick has passed in STATE_BLOCKED_MEMORY
+};
+struct _tcb* tcb;
+
+// cpu load, counted in 1 s epochs, a task's count is only folded into its
+// averages the next time it is switched or read, so systick never walks the tcbs
+#define EPOCH_TICKS 1000
+#define CYCLES_PER_LOAD_UNIT 19531 // 40e6 clocks per epoch / LOAD_FIXED_1
+const uint16_t loadExp[LOAD_WINDOWS] = {753, 1853, 2014};   // LOAD_FIXED_1 * exp(-1/1, -1/10, -1/60)
+// loadExp raised to 1, 2, 4 .. 256, idle epochs missed by a task decay in one
+// multiply per set bit, past LOAD_DECAY_MAX even the 60 s average is 0
+#define LOAD_DECAY_BITS 9
+#define LOAD_DECAY_MAX (8 * 60)
+const uint16_t loadDecay[LOAD_WINDOWS][LOAD_DECAY_BITS] =
+{
+    {753, 277, 37, 1, 0, 0, 0, 0, 0},
+    {1853, 1677, 1372, 920, 413, 83, 3, 0, 0},
+    {2014, 1981, 1915, 1791, 1567, 1199, 701, 240, 28}
+};
+uint32_t epoch = 0;
+uint16_t epochTicks = 0;
+uint32_t busyCycles = 0;           // clocks of non idle tasks in this epoch
+uint32_t switchCycles = 0;         // DWT_CYCCNT when the current task was switched in
 
-#define TASK_CPU_TIME_PERIOD 2000  // x milliseconds to update CPU time consumed by each task
-bool pingPong = false;
-uint16_t clockCounter = 0;         // keeps a timer
-uint32_t startTimer = 0, endTimer = 0;
+// stack high water mark, stacks are painted when created or restarted, the
+// lowest overwritten word is found by scanning up from the base
+#define STACK_PAINT 0xA5A5A5A5
+#define STACK_SCAN_WORDS 32        // words checked per switch into idle
+#define STACK_MARGIN 64            // bytes added to the peak in the recommendation
+uint8_t stackScanTask = 0;
+
+// guard is the lowest subregion of the allocation, 512 B or 1 KB depending on
+// where it lands, larger subregions are not spent on a guard
+#define STACK_GUARD_MAX 1024
+
+// task fault handed over by faultHandler, pendsv kills the task once its
+// context is saved and can be thrown away, the frame is in lastFault
+bool faultPending = false;
+uint8_t faultTask = 0;
+bool faultRestart = false;         // restart tasks killed by a fault, overflows always are
+
+// memory pressure, a failed allocation notifies the tasks that registered
+// reclaim bits so they free their caches, a waiter still short of free
+// subregions after a whole tick of that goes to the oom policy
+uint32_t reclaimBits[MAX_TASKS];   // notification bits sent on pressure, 0 if not registered
+bool oomExempt[MAX_TASKS];         // never picked by the oom policy
+uint8_t oomPolicy = OOM_NONE;
+uint32_t pressureEvents = 0;
+uint32_t oomKills = 0;
+uint32_t memWaitReleases = 0;      // heapReleases when the waiters last retried
+
+// the last kills, systick does not print so meminfo shows them,
+// oomKills % OOM_LOG_SIZE is the next slot
+#define OOM_LOG_SIZE 4
+typedef struct _OOM_RECORD
+{
+    uint32_t tick;
+    uint32_t size;                 // bytes the requester asked for
+    uint32_t footprint;            // bytes the victim held
+    uint8_t victim;                // tcb indexes
+    uint8_t requester;
+} OOM_RECORD;
+OOM_RECORD oomLog[OOM_LOG_SIZE];
 
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
+void handleTaskFault(void);
+void killThread(_fn fn);
+
 bool initMutex(uint8_t mutex)
 {
     bool ok = (mutex < MAX_MUTEXES);
@@ -138,20 +274,50 @@ bool initSemaphore(uint8_t semaphore, uint8_t count)
     return ok;
 }
 
+bool initQueue(uint8_t queue)
+{
+    bool ok = (queue < MAX_QUEUES);
+    if (ok)
+    {
+        ringInit(&queues[queue].ring, queueStorage[queue], MAX_QUEUE_RECORDS, sizeof(uint32_t));
+        queues[queue].queueSize = 0;
+    }
+    return ok;
+}
+
+// masks kernel aware interrupts, returns the mask to restore
+uint32_t enterCritical(void)
+{
+    uint32_t basepri = getBasepri();
+    raiseBasepri(KERNEL_INT_PRIORITY << 5);     // priority in upper 3 bits
+    return basepri;
+}
+
+void leaveCritical(uint32_t basepri)
+{
+    setBasepri(basepri);
+}
+
 // REQUIRED: initialize systick for 1ms system timer
 void initRtos(void)
 {
-    uint8_t i;
+    uint32_t i;
     // no tasks running
     taskCount = 0;
-    // clear out tcb records
-    for (i = 0; i < MAX_TASKS; i++)
-    {
-        tcb[i].state = STATE_INVALID;
-        tcb[i].pid = 0;
-        tcb[i].clockA = 0;
-        tcb[i].clockB = 0;
-    }
+    initKdata();
+    initRegistry();
+    // clear out tcb records, all zero is STATE_INVALID with nothing pending
+    tcb = (struct _tcb*)mallocFromHeap(MAX_TASKS * sizeof(struct _tcb));
+    for (i = 0; i < MAX_TASKS * sizeof(struct _tcb) / 4; i++)
+        ((uint32_t*)tcb)[i] = 0;
+    initCycleCounter();
+    initCrash();
+
+    // kernel exceptions share one level so svc and systick never nest, pendsv at
+    // the bottom, zero latency interrupts stay above all of them
+    NVIC_SYS_PRI2_R = (NVIC_SYS_PRI2_R & ~NVIC_SYS_PRI2_SVC_M) | (KERNEL_INT_PRIORITY << 29);
+    NVIC_SYS_PRI3_R = (NVIC_SYS_PRI3_R & ~(NVIC_SYS_PRI3_TICK_M | NVIC_SYS_PRI3_PENDSV_M))
+                    | (KERNEL_INT_PRIORITY << 29) | (PENDSV_INT_PRIORITY << 21);
 
     // setup system timer
     NVIC_ST_RELOAD_R  = 40e3 - 1;   // sysTick will 1 millisecond muti-shot timer
@@ -219,12 +385,313 @@ void startRtos(void)
 {
     // enable Memory Protection Unit
     NVIC_MPU_CTRL_R |= NVIC_MPU_CTRL_PRIVDEFEN | NVIC_MPU_CTRL_ENABLE;
-    setPsp((uint32_t*)0x20008000);
+    setPsp((uint32_t*)SRAM_END);
     goThreadMode();         // switch to thread mode by setting ASP
     goUserMode();           // changes from privilege to un-privilege,  TMPL bit
     __asm(" SVC #0");       // service call, requesting kernel to do privilege task
 }
 
+void paintStack(uint8_t task)
+{
+    uint32_t* p = (uint32_t*)((uint32_t)tcb[task].spInit - tcb[task].size);
+    uint32_t words = tcb[task].size / 4;
+    uint32_t i;
+    for (i = 0; i < words; i++)
+        p[i] = STACK_PAINT;
+    tcb[task].stackFree = words;
+    tcb[task].stackScan = 0;
+}
+
+// a pass walks up from the base and ends at the first overwritten word or at
+// the last known mark, usage only grows so the mark only moves down,
+// returns what is left of budget
+uint32_t scanStack(uint8_t task, uint32_t budget)
+{
+    uint32_t* base = (uint32_t*)((uint32_t)tcb[task].spInit - tcb[task].size);
+    while (budget != 0)
+    {
+        if (tcb[task].stackScan >= tcb[task].stackFree)
+        {
+            tcb[task].stackScan = 0;            // nothing new, start over
+            return budget;
+        }
+        if (base[tcb[task].stackScan] != STACK_PAINT)
+        {
+            tcb[task].stackFree = tcb[task].stackScan;
+            tcb[task].stackScan = 0;
+            return budget - 1;
+        }
+        tcb[task].stackScan++;
+        budget--;
+    }
+    return 0;
+}
+
+// idle time work, called while switching to the idle task
+void scanStacks(uint32_t budget)
+{
+    uint8_t tries = taskCount;
+    while (budget != 0 && tries-- != 0)
+    {
+        if (stackScanTask >= taskCount)
+            stackScanTask = 0;
+        if (tcb[stackScanTask].state != STATE_INVALID && tcb[stackScanTask].state != STATE_STOPPED)
+        {
+            budget = scanStack(stackScanTask, budget);
+            if (tcb[stackScanTask].stackScan != 0)
+                return;                         // pass not finished, continue here next time
+        }
+        stackScanTask++;
+    }
+}
+
+// finishes the scan at once, for ps and meminfo
+uint32_t stackPeak(uint8_t task)
+{
+    do
+        scanStack(task, 0xFFFFFFFF);
+    while (tcb[task].stackScan != 0);
+    return tcb[task].size - tcb[task].stackFree * 4;
+}
+
+// smallest allocation that holds the peak plus a margin, in 512 B subregions
+uint32_t stackRecommended(uint32_t peak)
+{
+    return ((peak + STACK_MARGIN + 511) / 512) * 512;
+}
+
+// lays the stack out in total bytes at spBase, a guard subregion at the bottom
+// is kept out of the srd window, spInit is the allocation end
+// a heap plan with subregions above STACK_GUARD_MAX (large SRAM boards) can put
+// the stack where a guard would eat it, the task then runs unguarded
+void placeStack(uint8_t task, void* spBase, uint32_t total, bool guard)
+{
+    uint16_t guardSize = subregionSizeOf((uint32_t)spBase);
+    tcb[task].guard = (guard && guardSize <= STACK_GUARD_MAX) ? guardSize : 0;
+    tcb[task].size = total - tcb[task].guard;
+    tcb[task].spInit = (void*)((uint32_t)spBase + total);
+    tcb[task].sp = tcb[task].spInit;
+    tcb[task].srd = createNoSramAccessMask();
+    addSramAccessWindow(&(tcb[task].srd), (uint32_t*)((uint32_t)spBase + tcb[task].guard), tcb[task].size);
+    paintStack(task);
+    tcb[task].sp = runFn(tcb[task].sp, tcb[task].pid);
+}
+
+// a guarded stack grows by the one subregion it starts in, sizes are tried
+// from the smallest up and a try that lands on a larger subregion is given
+// back, total is what was allocated, 0 if the heap is out of room
+void* mallocStack(uint32_t stackBytes, bool guard, uint32_t* total)
+{
+    uint8_t i;
+    void* spBase;
+    for (i = 0; guard && i < NUM_SUBREGION_SIZES && subregionSizes[i] <= STACK_GUARD_MAX; i++)
+    {
+        bool last = (i + 1 == NUM_SUBREGION_SIZES) || (subregionSizes[i + 1] > STACK_GUARD_MAX);
+        spBase = mallocFromHeap(stackBytes + subregionSizes[i]);
+        if (spBase && (last || subregionSizeOf((uint32_t)spBase) <= subregionSizes[i]))
+        {
+            *total = stackBytes + subregionSizes[i];
+            return spBase;
+        }
+        if (spBase)
+            freeToHeap(spBase);
+    }
+    *total = stackBytes;
+    return mallocFromHeap(stackBytes);      // unguarded, or no size small enough for a guard
+}
+
+// new stack for a stopped task, false if the heap is out of room
+bool restartTask(uint8_t task)
+{
+    uint32_t total;
+    bool guard = (tcb[task].stackBytes & STACK_GUARD) != 0;
+    void* spBase = mallocStack(tcb[task].stackBytes & ~STACK_GUARD, guard, &total);
+    if (!spBase)
+        return false;
+    placeStack(task, spBase, total, guard);
+    tcb[task].state = STATE_READY;
+    return true;
+}
+
+// heap allocation opened in the task's srd window and owned by it, so it is
+// freed with the task, 0 if the heap is out of room
+uint32_t mallocForTask(uint8_t task, uint32_t size)
+{
+    uint32_t address = (uint32_t)mallocFromHeap(size);
+    if (address < HEAP_ADDRESS || address >= HEAP_END)
+        return 0;
+    uint64_t srdMask = createNoSramAccessMask();
+    addSramAccessWindow(&srdMask, (uint32_t*)address, size);
+    tcb[task].srd &= srdMask;
+    if (task == taskCurrent)                        // systick allocates for memory waiters
+        applySramAccessMask(tcb[task].srd);
+    setAllocationOwner((void*)address, task);       // assign the allocated parent
+    return address;
+}
+
+// buffer an svc caller hands the kernel, the kernel runs privileged so it has
+// to check the task could have reached it itself, flash is readable by all
+bool isTaskBuffer(uint8_t task, uint32_t address, uint32_t size, bool write)
+{
+    if (!write && size != 0 && address < FLASH_END && size <= FLASH_END - address)
+        return true;
+    return sramWindowOpen(tcb[task].srd, address, size);
+}
+
+// name passed to an svc, not empty and readable up to its terminator or
+// length bytes, the kernel copies no more than that
+bool isTaskString(uint8_t task, uint32_t address, uint8_t length)
+{
+    uint8_t i;
+    for (i = 0; i < length; i++)
+    {
+        if (!isTaskBuffer(task, address + i, 1, false))
+            return false;
+        if (((char*)address)[i] == 0)
+            return i != 0;
+    }
+    return true;
+}
+
+// what a task may free or resize itself, its stack is kernel owned and the
+// sub-heap and pools keep their allocation until the task dies
+bool isTaskAllocation(uint8_t task, uint32_t address)
+{
+    return allocationOwner((void*)address) == task && (void*)address != kdata.task[task].subheap
+            && !poolOwnsAllocation((void*)address) && shareOfBase(address) < 0;
+}
+
+// merges the share's window into the task's srd mask, or takes it out again
+void setShareAccess(int8_t share, uint8_t task, uint8_t access)
+{
+    uint64_t srdMask = createNoSramAccessMask();
+    uint16_t bit = 1 << task;
+    addSramAccessWindow(&srdMask, (uint32_t*)shares[share].base, shares[share].size);
+    shares[share].readers &= ~bit;
+    shares[share].writers &= ~bit;
+    if (access == SHARE_NONE)
+        tcb[task].srd |= ~srdMask;
+    else
+    {
+        tcb[task].srd &= srdMask;
+        if (access == SHARE_READ)
+            shares[share].readers |= bit;
+        else
+            shares[share].writers |= bit;
+    }
+    if (task == taskCurrent)
+        applySramAccessMask(tcb[task].srd);
+}
+
+// closes the share's window in every grantee and frees the slot, the
+// allocation itself stays with the owner
+void revokeShare(int8_t share)
+{
+    uint8_t i;
+    for (i = 0; i < MAX_TASKS; i++)
+        if (shareGrantees(share) & (1 << i))
+            setShareAccess(share, i, SHARE_NONE);
+    shares[share].inUse = false;
+}
+
+// an owner's shares are revoked everywhere, its allocation is freed with the
+// rest, a grantee just drops out of the grant lists
+void releaseShares(uint8_t task)
+{
+    int8_t i;
+    for (i = 0; i < MAX_SHARES; i++)
+    {
+        if (!shares[i].inUse)
+            continue;
+        if (shares[i].owner == task)
+            revokeShare(i);
+        else
+        {
+            shares[i].readers &= ~(1 << task);
+            shares[i].writers &= ~(1 << task);
+        }
+    }
+}
+
+// the window is closed before the subregions can go to another task
+void freeForTask(uint8_t task, uint32_t address)
+{
+    uint64_t srdMask = createNoSramAccessMask();
+    addSramAccessWindow(&srdMask, (uint32_t*)address, allocationSize((void*)address));
+    tcb[task].srd |= ~srdMask;
+    if (task == taskCurrent)
+        applySramAccessMask(tcb[task].srd);
+    freeToHeap((void*)address);
+}
+
+// in place when the subregions above are free or the allocation shrinks, the
+// old window is closed and the new one opened, otherwise a new allocation,
+// copy and free, 0 with the old allocation untouched if neither works
+uint32_t reallocForTask(uint8_t task, uint32_t address, uint32_t size)
+{
+    uint32_t oldSize = allocationSize((void*)address);
+    uint64_t oldMask = createNoSramAccessMask();
+    uint32_t newAddress, i;
+    addSramAccessWindow(&oldMask, (uint32_t*)address, oldSize);
+    if (resizeInHeap((void*)address, size))
+    {
+        uint64_t newMask = createNoSramAccessMask();
+        addSramAccessWindow(&newMask, (uint32_t*)address, size);
+        tcb[task].srd = (tcb[task].srd | ~oldMask) & newMask;
+        if (task == taskCurrent)
+            applySramAccessMask(tcb[task].srd);
+        return address;
+    }
+    newAddress = mallocForTask(task, size);
+    if (!newAddress)
+        return 0;
+    if (size > oldSize)
+        size = oldSize;
+    for (i = 0; i < size / 4; i++)
+        ((uint32_t*)newAddress)[i] = ((uint32_t*)address)[i];      // both are subregion aligned
+    for (i *= 4; i < size; i++)
+        ((uint8_t*)newAddress)[i] = ((uint8_t*)address)[i];
+    freeForTask(task, address);
+    return newAddress;
+}
+
+// task whose stack, guard included, holds address, MAX_TASKS if none
+uint8_t taskOfStack(uint32_t address)
+{
+    uint8_t i;
+    for (i = 0; i < taskCount; i++)
+    {
+        uint32_t top = (uint32_t)tcb[i].spInit;
+        uint32_t bottom = top - tcb[i].size - tcb[i].guard;
+        if (tcb[i].state != STATE_INVALID && tcb[i].state != STATE_STOPPED && address >= bottom && address <= top)
+            return i;
+    }
+    return MAX_TASKS;
+}
+
+// by pid, a user task may run at the lowest priority as well
+bool isIdleTask(uint8_t task)
+{
+    return tcb[task].pid == (void*)idle;
+}
+
+uint32_t taskStackTop(uint8_t task)
+{
+    return (uint32_t)tcb[task].spInit;
+}
+
+// allocation base of the stack, the guard included, as freeToHeap takes it
+void* taskStackBase(uint8_t task)
+{
+    return (void*)((uint32_t)tcb[task].spInit - tcb[task].size - tcb[task].guard);
+}
+
+bool inStackGuard(uint8_t task, uint32_t address)
+{
+    uint32_t bottom = (uint32_t)tcb[task].spInit - tcb[task].size - tcb[task].guard;
+    return (tcb[task].guard != 0) && (address >= bottom) && (address < bottom + tcb[task].guard);
+}
+
 // REQUIRED:
 // add task if room in task list
 // store the thread name
@@ -245,7 +712,10 @@ bool createThread(_fn fn, const char name[], uint8_t priority, uint32_t stackByt
         }
         if (!found)
         {
-            void* spBase = mallocFromHeap(stackBytes);
+            uint32_t request = stackBytes;
+            bool guard = (stackBytes & STACK_GUARD) != 0;
+            stackBytes &= ~STACK_GUARD;
+            void* spBase = mallocStack(stackBytes, guard, &stackBytes);
             if (!spBase)
                 return ok;
             // find first available tcb record
@@ -253,18 +723,20 @@ bool createThread(_fn fn, const char name[], uint8_t priority, uint32_t stackByt
             while (tcb[i].state != STATE_INVALID) {i++;}
             tcb[i].state = STATE_READY;
             tcb[i].pid = fn;
-            tcb[i].sp = (void*)((uint32_t)spBase + stackBytes);         // initially points top of the stack
-            tcb[i].spInit = (void*)((uint32_t)spBase + stackBytes);     // points top of the stack
             tcb[i].priority = priority;
             tcb[i].currentPriority = priority;
-            tcb[i].size = stackBytes;
-            tcb[i].srd = createNoSramAccessMask();
-            addSramAccessWindow(&(tcb[i].srd), (uint32_t*)spBase, stackBytes);
+            tcb[i].stackBytes = request;
             strCpy(name, tcb[i].name);
-
-            tcb[i].sp = runFn(tcb[i].sp, tcb[i].pid);       // runs fn (stores registers on stack and update sp)
+            tcb[i].epoch = epoch;
+            tcb[i].epochCycles = 0;
+            tcb[i].load[0] = tcb[i].load[1] = tcb[i].load[2] = 0;
+            placeStack(i, spBase, stackBytes, guard);      // runs fn (stores registers on stack and update sp)
 
             taskCount++;            // increment task count
+            kdataWriteBegin();
+            kdata.task[i].pid = fn;
+            kdata.taskCount = taskCount;
+            kdataWriteEnd();
             ok = true;
         }
     }
@@ -277,6 +749,41 @@ void mallocRequest(uint32_t size, void** address)
     __asm(" STR R0, [R1]");
 }
 
+// only the task that owns the allocation can free it
+void freeRequest(void* address)
+{
+    __asm(" SVC #38");
+}
+
+// returns the resized allocation, which may have moved, or 0 with the old one
+// still valid, a 0 address allocates and a 0 size frees
+void* reallocRequest(void* address, uint32_t size)
+{
+    __asm(" SVC #39");
+    return (void*)reg0();
+}
+
+// waits up to timeout ticks for the heap, MEM_WAIT_FOREVER never gives up,
+// only a waiter can get the oom policy to make room, and only once the
+// reclaimers have had a tick
+void* mallocWait(uint32_t size, uint32_t timeout)
+{
+    __asm(" SVC #43");
+    return (void*)reg0();
+}
+
+// bits are notified to the task when an allocation fails, so it can free
+// caches, an exempt task is never killed by the oom policy
+void setMemoryPressure(uint32_t bits, bool exempt)
+{
+    __asm(" SVC #44");
+}
+
+void setOomPolicy(uint8_t policy)
+{
+    __asm(" SVC #45");
+}
+
 // REQUIRED: modify this function to restart a thread
 void restartThread(_fn fn)
 {
@@ -333,11 +840,340 @@ void post(int8_t semaphore)
     __asm(" SVC #6");
 }
 
+void setFlags(uint8_t group, uint32_t flags)
+{
+    __asm(" SVC #21");
+}
+
+// returns the flags of mask that were set, and clears them
+uint32_t waitFlags(uint8_t group, uint32_t mask)
+{
+    __asm(" SVC #22");
+    return reg0();
+}
+
+void notify(_fn fn, uint32_t bits)
+{
+    __asm(" SVC #23");
+}
+
+// returns all pending notification bits, and clears them
+uint32_t waitNotify(void)
+{
+    __asm(" SVC #24");
+    return reg0();
+}
+
+// false if queue is full
+bool queueSend(uint8_t queue, uint32_t message)
+{
+    __asm(" SVC #25");
+    return (bool)reg0();
+}
+
+uint32_t queueReceive(uint8_t queue)
+{
+    __asm(" SVC #26");
+    return reg0();
+}
+
+//-----------------------------------------------------------------------------
+// Kernel object helpers, shared by the svc and the FromIsr paths
+//-----------------------------------------------------------------------------
+
+// value a blocked task sees in R0 when its svc returns
+// the task may not be switched out yet (pendsv still pending), so the value is
+// held in the tcb and written to the stacked R0 when pendsv switches it back in
+void setTaskReturn(uint8_t task, uint32_t value)
+{
+    tcb[task].retValue = value;
+    tcb[task].retPending = true;
+}
+
+uint8_t taskIndexOf(void* pid)
+{
+    uint8_t i;
+    for (i = 0; i < taskCount; i++)
+        if (tcb[i].pid == pid)
+            return i;
+    return MAX_TASKS;
+}
+
+// removes entry at index from a wait queue, shifting the rest down by 1 index
+void removeWaiter(uint8_t processQueue[], uint8_t* queueSize, uint8_t index)
+{
+    uint8_t k;
+    (*queueSize)--;
+    for (k = index; k < *queueSize; k++)
+        processQueue[k] = processQueue[k + 1];
+}
+
+// returns true if a blocked task was made ready
+bool semaphorePost(uint8_t s)
+{
+    bool woken = false;
+    semaphores[s].count++;                 // free shared access
+
+    if (semaphores[s].queueSize > 0)      // if any task in queue for resource, then give it access
+    {
+        uint8_t nextTaskId = semaphores[s].processQueue[0];
+        semaphores[s].count--;
+        traceEvent(TRACE_WAKE, nextTaskId, tcb[nextTaskId].state);
+        tcb[nextTaskId].state = STATE_READY;
+        removeWaiter(semaphores[s].processQueue, &semaphores[s].queueSize, 0);
+        woken = true;
+    }
+    return woken;
+}
+
+bool flagsSet(uint8_t group, uint32_t flags)
+{
+    bool woken = false;
+    uint8_t i = 0;
+    flagGroups[group].flags |= flags;
+    while (i < flagGroups[group].queueSize)
+    {
+        uint8_t task = flagGroups[group].processQueue[i];
+        uint32_t match = flagGroups[group].flags & tcb[task].flagMask;
+        if (match)
+        {
+            flagGroups[group].flags &= ~match;       // consumed by the waiter
+            setTaskReturn(task, match);
+            traceEvent(TRACE_WAKE, task, tcb[task].state);
+            tcb[task].state = STATE_READY;
+            removeWaiter(flagGroups[group].processQueue, &flagGroups[group].queueSize, i);
+            woken = true;
+        }
+        else
+            i++;
+    }
+    return woken;
+}
+
+bool notifyGive(uint8_t task, uint32_t bits)
+{
+    bool woken = false;
+    tcb[task].notifyValue |= bits;
+    if (tcb[task].state == STATE_BLOCKED_NOTIFY)
+    {
+        setTaskReturn(task, tcb[task].notifyValue);
+        tcb[task].notifyValue = 0;
+        traceEvent(TRACE_WAKE, task, tcb[task].state);
+        tcb[task].state = STATE_READY;
+        woken = true;
+    }
+    return woken;
+}
+
+// a waiting receiver means the queue is empty, so hand the message over directly
+bool queuePut(uint8_t q, uint32_t message, bool* woken)
+{
+    *woken = false;
+    if (queues[q].queueSize > 0)
+    {
+        uint8_t task = queues[q].processQueue[0];
+        setTaskReturn(task, message);
+        traceEvent(TRACE_WAKE, task, tcb[task].state);
+        tcb[task].state = STATE_READY;
+        removeWaiter(queues[q].processQueue, &queues[q].queueSize, 0);
+        *woken = true;
+        return true;
+    }
+    return ringPutRecord(&queues[q].ring, &message);
+}
+
+// wakes the registered reclaimers, they free what they can with freeRequest
+// and the waiters retry once subregions come back
+void memoryPressure(uint8_t task)
+{
+    uint8_t i;
+    bool woken = false;
+    pressureEvents++;
+    for (i = 0; i < taskCount; i++)
+        if (i != task && reclaimBits[i] && tcb[i].state != STATE_INVALID && tcb[i].state != STATE_STOPPED)
+            woken |= notifyGive(i, reclaimBits[i]);
+    if (woken && preemption)
+        NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;
+}
+
+// stack, guard included, and every allocation on the task's list
+uint32_t taskFootprint(uint8_t task)
+{
+    uint32_t bytes = tcb[task].size + tcb[task].guard;
+    uint8_t r;
+    for (r = taskAllocations[task]; r != NO_ALLOCATION; r = allocatedData[r].next)
+        bytes += allocatedData[r].size;
+    return bytes;
+}
+
+// never the requester, idle, an exempt task or one whose memory would still
+// leave the request short, ties on priority go to the larger footprint,
+// MAX_TASKS if nothing can be killed
+uint8_t oomVictim(uint8_t requester, uint32_t size)
+{
+    uint32_t freeBytes = getFreeSpace();
+    uint8_t i, victim = MAX_TASKS;
+    for (i = 0; i < taskCount; i++)
+    {
+        if (i == requester || oomExempt[i] || isIdleTask(i)
+                || tcb[i].state == STATE_INVALID || tcb[i].state == STATE_STOPPED
+                || freeBytes + taskFootprint(i) < size)
+            continue;
+        if (victim == MAX_TASKS)
+            victim = i;
+        else if (oomPolicy == OOM_KILL_LOWEST && tcb[i].priority != tcb[victim].priority)
+        {
+            if (tcb[i].priority > tcb[victim].priority)
+                victim = i;
+        }
+        else if (taskFootprint(i) > taskFootprint(victim))
+            victim = i;
+    }
+    return victim;
+}
+
+// true if the policy killed a task, so the allocation is worth another try,
+// a request that fails on fragmentation or a full registry kills nothing as
+// the victim's subregions may not help it
+bool oomKill(uint8_t requester, uint32_t size)
+{
+    OOM_RECORD* record;
+    uint8_t victim;
+    if (oomPolicy == OOM_NONE || getFreeSpace() >= size)
+        return false;
+    victim = oomVictim(requester, size);
+    if (victim == MAX_TASKS)
+        return false;
+    record = &oomLog[oomKills % OOM_LOG_SIZE];
+    record->tick = (uint32_t)kdata.tick;
+    record->size = size;
+    record->footprint = taskFootprint(victim);
+    record->victim = victim;
+    record->requester = requester;
+    killThread((_fn)tcb[victim].pid);
+    oomKills++;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Handler mode services
+// SVC from an ISR escalates to a hard fault, so these change kernel state
+// directly inside a BASEPRI critical section and leave the task switch to
+// one PendSV, which runs once every ISR has exited
+//-----------------------------------------------------------------------------
+
+void requestSwitchFromIsr(bool woken)
+{
+    if (woken && preemption)
+        NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;
+}
+
+void postFromIsr(int8_t semaphore)
+{
+    uint32_t basepri;
+    bool woken;
+    if (semaphore < 0 || semaphore >= MAX_SEMAPHORES)
+        return;
+    basepri = enterCritical();
+    woken = semaphorePost(semaphore);
+    leaveCritical(basepri);
+    requestSwitchFromIsr(woken);
+}
+
+void setFlagsFromIsr(uint8_t group, uint32_t flags)
+{
+    uint32_t basepri;
+    bool woken;
+    if (group >= MAX_FLAG_GROUPS)
+        return;
+    basepri = enterCritical();
+    woken = flagsSet(group, flags);
+    leaveCritical(basepri);
+    requestSwitchFromIsr(woken);
+}
+
+void notifyFromIsr(_fn fn, uint32_t bits)
+{
+    uint32_t basepri;
+    bool woken = false;
+    uint8_t task;
+    basepri = enterCritical();
+    task = taskIndexOf((void*)fn);
+    if (task < MAX_TASKS)
+        woken = notifyGive(task, bits);
+    leaveCritical(basepri);
+    requestSwitchFromIsr(woken);
+}
+
+bool queueSendFromIsr(uint8_t queue, uint32_t message)
+{
+    uint32_t basepri;
+    bool ok, woken;
+    if (queue >= MAX_QUEUES)
+        return false;
+    basepri = enterCritical();
+    ok = queuePut(queue, message, &woken);
+    leaveCritical(basepri);
+    requestSwitchFromIsr(woken);
+    return ok;
+}
+
+// one step of the exponential average, active is this epoch's use
+uint16_t calcLoad(uint16_t load, uint16_t exp, uint32_t active)
+{
+    return (load * exp + active * (LOAD_FIXED_1 - exp)) >> LOAD_FSHIFT;
+}
+
+// closes the task's epoch if time moved on, epochs it was never switched in
+// count as idle, runs in pendsv so the catch up is bounded by LOAD_DECAY_BITS
+void foldTaskLoad(uint8_t task)
+{
+    uint32_t active, missed;
+    uint8_t w, bit;
+    if (tcb[task].epoch == epoch)
+        return;
+    active = tcb[task].epochCycles / CYCLES_PER_LOAD_UNIT;
+    if (active > LOAD_FIXED_1)
+        active = LOAD_FIXED_1;
+    for (w = 0; w < LOAD_WINDOWS; w++)
+        tcb[task].load[w] = calcLoad(tcb[task].load[w], loadExp[w], active);
+    missed = epoch - tcb[task].epoch - 1;
+    for (w = 0; w < LOAD_WINDOWS; w++)
+    {
+        if (missed >= LOAD_DECAY_MAX)
+            tcb[task].load[w] = 0;
+        else
+            for (bit = 0; bit < LOAD_DECAY_BITS; bit++)
+                if (missed & (1 << bit))
+                    tcb[task].load[w] = calcLoad(tcb[task].load[w], loadDecay[w][bit], 0);
+    }
+    tcb[task].epoch = epoch;
+    tcb[task].epochCycles = 0;
+}
+
 // REQUIRED: modify this function to add support for the system timer
 // REQUIRED: in preemptive code, add code to request task switch
 void systickIsr(void)
 {
+    uint32_t releases = heapReleases;  // frees before this tick, a kill below is not one yet
     uint8_t i = 0;
+    kdataWriteBegin();
+    kdata.tick++;
+    kdata.task[taskCurrent].ticks++;
+    // system average is one fold per epoch, task averages are lazy
+    if (++epochTicks >= EPOCH_TICKS)
+    {
+        uint32_t active = busyCycles / CYCLES_PER_LOAD_UNIT;
+        if (active > LOAD_FIXED_1)
+            active = LOAD_FIXED_1;
+        for (i = 0; i < LOAD_WINDOWS; i++)
+            kdata.load[i] = calcLoad(kdata.load[i], loadExp[i], active);
+        busyCycles = 0;
+        epochTicks = 0;
+        epoch++;
+    }
+    kdataWriteEnd();
+
     for (i = 0; i < taskCount; i++)
     {
         if (tcb[i].state == STATE_DELAYED)
@@ -345,24 +1181,41 @@ void systickIsr(void)
             if (tcb[i].ticks != 0)          // task ticker
                 (tcb[i].ticks)--;
             if (tcb[i].ticks == 0)          // timer expired, do task
+            {
+                traceEvent(TRACE_WAKE, i, tcb[i].state);
                 tcb[i].state = STATE_READY;
+            }
+        }
+        else if (tcb[i].state == STATE_BLOCKED_MEMORY)
+        {
+            // only worth a retry once something was freed before this tick,
+            // in task order
+            uint32_t address = (releases != memWaitReleases) ? mallocForTask(i, tcb[i].memRequest) : 0;
+            if (tcb[i].ticks != MEM_WAIT_FOREVER && tcb[i].ticks != 0)
+                (tcb[i].ticks)--;
+            // the reclaimers had a whole tick and nothing came back, one kill
+            // a tick, it frees at once but no waiter retries until the next
+            // tick so pendsv has switched out a victim that was running, the
+            // wait is stretched to cover it
+            if (!address && tcb[i].memWaited && releases == memWaitReleases
+                    && heapReleases == releases && oomKill(i, tcb[i].memRequest))
+            {
+                if (tcb[i].ticks == 0)
+                    tcb[i].ticks = 1;
+                NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;
+            }
+            else if (address || tcb[i].ticks == 0)
+            {
+                setTaskReturn(i, address);
+                traceEvent(TRACE_WAKE, i, tcb[i].state);
+                tcb[i].state = STATE_READY;
+            }
+            tcb[i].memWaited = true;
         }
     }
+    memWaitReleases = releases;        // a kill above shows as a release next tick
     if (preemption)
         NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;
-
-    clockCounter++;
-    if (clockCounter >= TASK_CPU_TIME_PERIOD)   // marks x seconds timer, in this project 2s
-    {
-        clockCounter = 0;
-        pingPong = !pingPong;           // switch clock buffers
-        if (!pingPong)
-            for (i = 0; i < taskCount; i++)
-                tcb[i].clockA = 0;
-        else
-            for (i = 0; i < taskCount; i++)
-                tcb[i].clockB = 0;
-    }
 }
 
 // REQUIRED: in coop and preemptive, modify this function to add support for task switching
@@ -374,49 +1227,55 @@ __attribute__((naked)) void pendSvIsr(void)
     // __asm(" PUSH {LR}");                     // exception return value, changes on any fnc call so store it'
     __asm(" MOV R1, LR");
     tcb[taskCurrent].sp = storeRegs();          // stores R4-11 and LR, and updates psp and psp value
+    // pendsv is the lowest priority, so mask kernel aware isrs while the tcbs
+    // and scheduler state are changed, zero latency isrs still get through
+    raiseBasepri(KERNEL_INT_PRIORITY << 5);
 
-    endTimer = NVIC_ST_CURRENT_R;
-    // if true, SysTick timer has counted to 0 since the last time this bit was read
-    if (startTimer < endTimer)
-        if (pingPong == false)
-            tcb[taskCurrent].clockA += (40e3 - endTimer) + startTimer;
-        else
-            tcb[taskCurrent].clockB += (40e3 - endTimer) + startTimer;
-    else
-        if (pingPong == false)
-            tcb[taskCurrent].clockA += startTimer - endTimer;
-        else
-            tcb[taskCurrent].clockB += startTimer - endTimer;
+    // unsigned difference is right across a CYCCNT wrap as long as a task runs
+    // under ~107 s without a switch, systick forces one every 1ms when preempting
+    {
+        uint32_t now = DWT_CYCCNT_R;
+        uint32_t delta = now - switchCycles;
+        switchCycles = now;
+        tcb[taskCurrent].cycles += delta;
+        tcb[taskCurrent].epochCycles += delta;
+        foldTaskLoad(taskCurrent);
+        if (!isIdleTask(taskCurrent))
+            busyCycles += delta;
+    }
 
 
-    if((NVIC_FAULT_STAT_R & NVIC_FAULT_STAT_IERR) || (NVIC_FAULT_STAT_R & NVIC_FAULT_STAT_DERR))
+    if (faultPending)
     {
-        NVIC_FAULT_STAT_R |= NVIC_FAULT_STAT_IERR | NVIC_FAULT_STAT_DERR;       // W1C
-        putsUart0("called from MPU\n");
-        uint32_t psp = getPsp();
-        uint8_t i;
-        for (i = 0; i < taskCount; i++)
-        {
-            uint32_t upperBound = (uint32_t)allocatedData[i].heapAddr;
-            uint32_t lowerBound = (uint32_t)allocatedData[i].heapAddr - allocatedData[i].size;
-            if (psp <= upperBound && psp > lowerBound)
-            {
-                freeToHeap(allocatedData[i].heapAddr);
-                break;
-            }
-        }
-        char hexString[10];
-        putsUart0("killed PID: "); putsUart0(uint32ToHexString((uint32_t*)&tcb[i].pid, hexString)); putsUart0("\n\n");
-        tcb[i].state = STATE_STOPPED;
-        putsUart0("\nuser@rtos:~$ ");
+        faultPending = false;
+        handleTaskFault();                      // sp saved above is dropped with the task
     }
     taskCurrent = rtosScheduler();
+    traceEvent(TRACE_SWITCH, taskCurrent, kdata.taskCurrent);     // page still holds the old task
+    kdataWriteBegin();
+    kdata.taskCurrent = taskCurrent;
+    kdata.task[taskCurrent].dispatches++;
+    kdataWriteEnd();
+    foldTaskLoad(taskCurrent);                  // new epoch starts clean for this task
+    if (isIdleTask(taskCurrent))
+        scanStacks(STACK_SCAN_WORDS);           // nothing else to run, spend a little on stacks
+    if (tcb[taskCurrent].retPending)
+    {
+        // sp points at R4-R11 and LR stored above, hw frame (R0 first) follows
+        ((uint32_t*)tcb[taskCurrent].sp)[9] = tcb[taskCurrent].retValue;
+        tcb[taskCurrent].retPending = false;
+    }
     applySramAccessMask(tcb[taskCurrent].srd);
     setPsp((uint32_t*)tcb[taskCurrent].sp);
-    startTimer = NVIC_ST_CURRENT_R;
+    setBasepri(0);
     restoreRegs();                              // restore r4-11 and never returns
 }
 
+char* taskNameOf(uint8_t task)
+{
+    return (task < taskCount) ? tcb[task].name : "?";
+}
+
 void* pidOfTask(char taskName[])
 {
     uint8_t i;
@@ -434,21 +1293,16 @@ void killThread(_fn fn)
     uint8_t i,k;
     for (i = 0; i < taskCount; i++)
     {
-        if (pid == tcb[i].pid)
+        // a stopped task's old stack base may now start another allocation
+        if (pid == tcb[i].pid && tcb[i].state != STATE_STOPPED && tcb[i].state != STATE_INVALID)
         {
             tcb[i].state = STATE_STOPPED;
-            freeToHeap(tcb[i].spInit);
+            freeToHeap(taskStackBase(i));
+            tcb[i].spInit = 0;
+            tcb[i].size = 0;
+            tcb[i].guard = 0;
             tcb[i].srd = createNoSramAccessMask();
-            for (k = 0; k < MAX_MEMORY_ALLOCATION; k++)
-            {
-                if (allocatedData[k].heapAddr == tcb[i].spInit) // mark the parent task, not in use
-                    allocatedData[k].inUse = false;
-                if (tcb[i].pid == allocatedData[k].fnPid)
-                {
-                    freeToHeap(allocatedData[k].heapAddr);     // if parent is removed, remove child allocation
-                    allocatedData[k].inUse = false;
-                }
-            }
+            freeTaskAllocations(i);             // if parent is removed, remove child allocation
             uint8_t j;
             // takes the task out of the mutex lock (giving it next in queue) or mutex queue (updates it)
             for (j = 0; j < MAX_MUTEXES; j++)
@@ -499,10 +1353,131 @@ void killThread(_fn fn)
                     }
                 }
             }
+            // takes the task out of event flag and message queue wait lists
+            for (j = 0; j < MAX_FLAG_GROUPS; j++)
+                for (k = 0; k < flagGroups[j].queueSize; k++)
+                    if (flagGroups[j].processQueue[k] == i)
+                        removeWaiter(flagGroups[j].processQueue, &flagGroups[j].queueSize, k--);
+            for (j = 0; j < MAX_QUEUES; j++)
+                for (k = 0; k < queues[j].queueSize; k++)
+                    if (queues[j].processQueue[k] == i)
+                        removeWaiter(queues[j].processQueue, &queues[j].queueSize, k--);
+            tcb[i].notifyValue = 0;
+            reclaimBits[i] = 0;
+            oomExempt[i] = false;
+            poolRelease(tcb[i].pid);
+            releaseShares(i);
+            kdataWriteBegin();
+            kdata.task[i].subheap = 0;              // window went with the child allocations
+            kdataWriteEnd();
         }
     }
 }
 
+// called by faultHandler, the work is left to pendsv
+void killFaultingTask(uint8_t task)
+{
+    faultTask = task;
+    faultPending = true;
+    NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;
+}
+
+// same cleanup as kill, an access into the task's guard subregion is a stack
+// overflow and always gets a fresh stack, other faults only with faultRestart
+void handleTaskFault(void)
+{
+    char hexString[10];
+    uint8_t i = faultTask;
+    bool overflow = inStackGuard(i, lastFault.psp) || (lastFault.address != 0 && inStackGuard(i, lastFault.address));
+    killThread((_fn)tcb[i].pid);
+    if (overflow)
+    {
+        putsUart0("stack overflow in "); putsUart0(tcb[i].name); putsUart0(", ");
+    }
+    if ((overflow || faultRestart) && restartTask(i))
+        putsUart0("restarted PID: ");
+    else
+        putsUart0("killed PID: ");
+    putsUart0(uint32ToHexString((uint32_t*)&tcb[i].pid, hexString)); putsUart0("\n\n");
+    putsUart0("\nuser@rtos:~$ ");
+}
+
+// space separated hex words, the form the tools/ decoders read
+void putsHexWords(const uint32_t values[], uint8_t count)
+{
+    char str[12];
+    uint8_t i;
+    for (i = 0; i < count; i++)
+    {
+        putcUart0(' ');
+        putsUart0(uint32ToHexString((uint32_t*)&values[i], str));
+    }
+    putcUart0('\n');
+}
+
+// readable summary, then the same numbers as a record tools/mmstat.py collects
+//   M tickHi tickLo heapSize free requested wasted largest frag% allocations
+//   L subregionSize largestRun       one per subregion size in the heap plan
+//   F size noSpace fragmented registry
+//   H <=64 <=128 <=256 <=512 <=1K <=2K <=4K <=8K >8K
+void printHeapStats(void)
+{
+    static char* failNames[ALLOC_FAIL_REASONS] = {"size", "no space", "fragmented", "registry full"};
+    HEAP_STATS stats;
+    uint32_t record[9];
+    char info[12];
+    uint8_t i;
+    getHeapStats(&stats);
+    putsUart0("Free space "); putsUart0(numToStr(stats.freeBytes, info));
+    putsUart0(" B of "); putsUart0(numToStr(HEAP_SIZE, info));
+    putsUart0(" B, largest run "); putsUart0(numToStr(stats.largestFree, info)); putsUart0(" B (");
+    for (i = 0; i < NUM_SUBREGION_SIZES; i++)
+    {
+        putsUart0(i ? ", " : ""); putsUart0(numToStr(subregionSizes[i], info));
+        putsUart0(" B blocks "); putsUart0(numToStr(stats.largestFreeOf[i], info)); putsUart0(" B");
+    }
+    putsUart0("), fragmentation "); putsUart0(numToStr(stats.fragmentation, info)); putsUart0("%\n");
+    putsUart0("Requested "); putsUart0(numToStr(stats.requestedBytes, info));
+    putsUart0(" B in "); putsUart0(numToStr(stats.allocations, info));
+    putsUart0(" allocations, "); putsUart0(numToStr(stats.wastedBytes, info)); putsUart0(" B lost to rounding\n");
+    putsUart0("Failed requests:");
+    for (i = 0; i < ALLOC_FAIL_REASONS; i++)
+    {
+        putsUart0(i ? ", " : " "); putsUart0(failNames[i]); putsUart0(" ");
+        putsUart0(numToStr(stats.failures[i], info));
+    }
+    putsUart0("\nRequest sizes:");
+    for (i = 0; i < HEAP_HISTOGRAM_BUCKETS; i++)
+    {
+        putsUart0((i < HEAP_HISTOGRAM_BUCKETS - 1) ? " <=" : " >");
+        putsUart0(numToStr((uint32_t)64 << ((i < HEAP_HISTOGRAM_BUCKETS - 1) ? i : i - 1), info));
+        putsUart0(":"); putsUart0(numToStr(stats.histogram[i], info));
+    }
+    putsUart0("\n#mmstat begin\nM");
+    record[0] = (uint32_t)(kdata.tick >> 32);
+    record[1] = (uint32_t)kdata.tick;
+    record[2] = HEAP_SIZE;
+    record[3] = stats.freeBytes;
+    record[4] = stats.requestedBytes;
+    record[5] = stats.wastedBytes;
+    record[6] = stats.largestFree;
+    record[7] = stats.fragmentation;
+    record[8] = stats.allocations;
+    putsHexWords(record, 9);
+    for (i = 0; i < NUM_SUBREGION_SIZES; i++)
+    {
+        putsUart0("L");
+        record[0] = subregionSizes[i];
+        record[1] = stats.largestFreeOf[i];
+        putsHexWords(record, 2);
+    }
+    putsUart0("F");
+    putsHexWords(stats.failures, ALLOC_FAIL_REASONS);
+    putsUart0("H");
+    putsHexWords(stats.histogram, HEAP_HISTOGRAM_BUCKETS);
+    putsUart0("#mmstat end\n");
+}
+
 // REQUIRED: modify this function to add support for the service call
 // REQUIRED: in preemptive code, add code to handle synchronization primitives
 //__attribute__((naked))
@@ -514,10 +1489,18 @@ void svCallIsr(void)
     uint8_t** pcPtr = (uint8_t**)(psp + 6);
     // SVC half-word instruction, so decrement by 2 to point at immediate value (8b)
     uint8_t imm = (uint8_t)(*(*pcPtr - 2));
+    uint8_t caller = taskCurrent;
+    uint8_t callerState = tcb[caller].state;
+    traceEvent(TRACE_SVC, caller, imm);
     switch(imm)
     {
     case START:
         taskCurrent = rtosScheduler();
+        kdataWriteBegin();
+        kdata.taskCurrent = taskCurrent;
+        kdata.task[taskCurrent].dispatches++;
+        kdataWriteEnd();
+        switchCycles = DWT_CYCCNT_R;
         setPsp((uint32_t*)tcb[taskCurrent].sp);
         applySramAccessMask(tcb[taskCurrent].srd);
         restoreRegs();
@@ -573,6 +1556,7 @@ void svCallIsr(void)
             if (mutexes[r0].queueSize > 0)      // if any task in queue for resource, then lock it again
             {
                 uint8_t i, nextTaskId = mutexes[r0].processQueue[0];
+                traceEvent(TRACE_WAKE, nextTaskId, tcb[nextTaskId].state);
                 tcb[nextTaskId].state = STATE_READY;
                 tcb[nextTaskId].mutex = r0;
                 mutexes[r0].lock = true;                        // lock mutex
@@ -584,8 +1568,7 @@ void svCallIsr(void)
         }
         else        // unprotected access, kill pid
         {
-            tcb[taskCurrent].state = STATE_STOPPED;
-            freeToHeap(tcb[taskCurrent].spInit);
+            killThread((_fn)tcb[taskCurrent].pid);
             NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;       // task is stopped, start other
         }
         break;
@@ -610,39 +1593,96 @@ void svCallIsr(void)
         // the value of R0, defines which semaphore is being used - always be 0
         if (r0 >= MAX_SEMAPHORES)                  // accessing non-exist resource
             break;
-        semaphores[r0].count++;                    // free shared access
-
-        if (semaphores[r0].queueSize > 0)      // if any task in queue for resource, then give it access
+        semaphorePost(r0);
+        break;
+    case MALLOC:
+        *psp = mallocForTask(taskCurrent, r0);          // 0 if out of room, the size used to come back
+        if (*psp == 0 && r0 != 0 && r0 <= HEAP_SIZE)
+            memoryPressure(taskCurrent);                // frees room for a later try, only waiters oom kill
+        break;
+    case MALLOC_WAIT: // r0 has the size, r1 the timeout in ticks, 0 does not wait
+        *psp = mallocForTask(taskCurrent, r0);
+        if (*psp == 0 && r0 != 0 && r0 <= HEAP_SIZE)
+            memoryPressure(taskCurrent);
+        if (*psp == 0 && r0 != 0 && r0 <= HEAP_SIZE && *(psp+1) != 0)
         {
-            uint8_t i, nextTaskId = semaphores[r0].processQueue[0];
-            semaphores[r0].count--;
-            semaphores[r0].queueSize--;
-            tcb[nextTaskId].state = STATE_READY;
-            for (i = 0; i < semaphores[r0].queueSize; i++)     // update the queue, shift the task down by 1 index
-                semaphores[r0].processQueue[i] = semaphores[r0].processQueue[i + 1];
+            tcb[taskCurrent].memRequest = r0;
+            tcb[taskCurrent].ticks = *(psp+1);
+            tcb[taskCurrent].memWaited = false;
+            tcb[taskCurrent].state = STATE_BLOCKED_MEMORY;
+            NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;   // systick retries and wakes the task
         }
-       break;
-    case MALLOC:
+        break;
+    case MEM_PRESSURE: // r0 has the reclaim notification bits, r1 the oom exemption
+        reclaimBits[taskCurrent] = r0;
+        oomExempt[taskCurrent] = (*(psp+1) != 0);
+        break;
+    case OOM:
+        if (r0 <= OOM_KILL_LARGEST)
+            oomPolicy = r0;
+        break;
+    case FREE:
+        if (isTaskAllocation(taskCurrent, r0))
+            freeForTask(taskCurrent, r0);
+        break;
+    case REALLOC: // r0 has the allocation, r1 the new size
     {
-        uint32_t address = (uint32_t)mallocFromHeap(r0);
-        if (address >= 0x20001000 && address < 0x20008000)
+        uint32_t size = *(psp+1);
+        if (r0 == 0)
+            *psp = mallocForTask(taskCurrent, size);
+        else if (!isTaskAllocation(taskCurrent, r0))
+            *psp = 0;
+        else if (size == 0)
         {
-            *psp = address;
-            uint64_t srdMask = createNoSramAccessMask();
-            addSramAccessWindow(&srdMask, (uint32_t*)address, r0);
-            tcb[taskCurrent].srd &= srdMask;
-            applySramAccessMask(tcb[taskCurrent].srd);
-
-            uint8_t i;
-            for (i = 0; i < MAX_MEMORY_ALLOCATION; i++)
-            {
-                if ((void*)(address+r0) == allocatedData[i].heapAddr)
-                {
-                    allocatedData[i].fnPid = tcb[taskCurrent].pid;     // assign the allocated parent
-                    break;
-                }
-            }
+            freeForTask(taskCurrent, r0);
+            *psp = 0;
+        }
+        else
+            *psp = reallocForTask(taskCurrent, r0, size);
+    }
+        break;
+    case SHARE_CREATE: // r0 has the name, r1 the size
+    {
+        uint32_t address = 0;
+        if (isTaskString(taskCurrent, r0, SHARE_NAME_SIZE))
+            address = mallocForTask(taskCurrent, *(psp+1));
+        if (address && shareSetup((const char*)r0, taskCurrent, address, *(psp+1)) < 0)
+        {
+            freeForTask(taskCurrent, address);              // name taken or no slot
+            address = 0;
+        }
+        *psp = address;
+    }
+        break;
+    case SHARE_GRANT: // r0 has the share base, r1 the task fn, r2 the access
+    {
+        int8_t share = shareOfBase(r0);
+        uint8_t task = taskIndexOf((void*)*(psp+1));
+        uint8_t access = *(psp+2);
+        bool ok = share >= 0 && shares[share].owner == taskCurrent && task < MAX_TASKS && task != taskCurrent
+                && tcb[task].state != STATE_STOPPED && (access == SHARE_NONE || access == SHARE_WRITE);
+        if (ok)
+            setShareAccess(share, task, access);
+        *psp = ok;
+    }
+        break;
+    case SHARE_OPEN: // r0 has the name
+    {
+        int8_t share = isTaskString(taskCurrent, r0, SHARE_NAME_SIZE) ? shareOfName((const char*)r0) : -1;
+        *psp = (share >= 0 && (shares[share].owner == taskCurrent || (shareGrantees(share) & (1 << taskCurrent))))
+                ? shares[share].base : 0;
+    }
+        break;
+    case SHARE_DESTROY: // r0 has the share base
+    {
+        int8_t share = shareOfBase(r0);
+        bool ok = share >= 0 && shares[share].owner == taskCurrent;
+        if (ok)
+        {
+            revokeShare(share);
+            freeForTask(taskCurrent, r0);
         }
+        *psp = ok;
     }
         break;
     case IPCS:
@@ -673,6 +1713,10 @@ void svCallIsr(void)
                 putsUart0("> keyReleased");
             else if (i == flashReq)
                 putsUart0("> flashReq");
+            else if (i == keyDown)
+                putsUart0("> keyDown");
+            else if (i == workReady)
+                putsUart0("> workReady");
             char count[5];
             numToStr(semaphores[i].count, count);
             putsUart0("  \t  user\t\t  666\t\t"); putsUart0(count); putcUart0('\n');
@@ -714,6 +1758,56 @@ void svCallIsr(void)
         else
             priorityInheritance = false;
         break;
+    case AUTORESTART:
+        faultRestart = (r0 != 0);
+        break;
+    case CRASH:
+        if (r0 == CRASH_CLEAR)
+            crashClear();
+        else
+            crashShow();
+        break;
+    case SUBHEAP_INIT:
+        // one window per task, a second call hands back the one already made
+        if (kdata.task[taskCurrent].subheap == 0)
+        {
+            uint32_t address = mallocForTask(taskCurrent, SUBHEAP_SIZE);
+            kdataWriteBegin();
+            kdata.task[taskCurrent].subheap = (void*)address;
+            kdataWriteEnd();
+        }
+        *psp = (uint32_t)kdata.task[taskCurrent].subheap;
+        break;
+    case POOL_CREATE: // r0 has the name, r1 the block size, r2 the block count
+    {
+        uint32_t blockSize = *(psp+1);
+        uint32_t blocks = *(psp+2);
+        uint32_t address;
+        uint8_t i;
+        *psp = (uint32_t)-1;
+        for (i = 0; i < MAX_POOLS && pools[i].inUse; i++);
+        if (i == MAX_POOLS || blockSize == 0 || blockSize > POOL_MAX_BLOCK_SIZE || blocks == 0
+                || blocks > POOL_MAX_BLOCKS || !isTaskString(taskCurrent, r0, POOL_NAME_SIZE))
+            break;
+        blockSize = poolBlockSize(blockSize);
+        if (blocks > HEAP_SIZE / blockSize)
+            break;
+        address = mallocForTask(taskCurrent, blockSize * blocks);
+        if (address)
+        {
+            *psp = poolSetup((const char*)r0, tcb[taskCurrent].pid, (void*)address, blockSize, blocks);
+            if ((int8_t)*psp < 0)
+                freeForTask(taskCurrent, address);
+        }
+    }
+        break;
+    case POOL_ALLOC: // blocks are only in the owner's window
+        *psp = (r0 < MAX_POOLS && pools[r0].owner == tcb[taskCurrent].pid) ? (uint32_t)poolTake(r0) : 0;
+        break;
+    case POOL_FREE:
+        if (r0 < MAX_POOLS && pools[r0].owner == tcb[taskCurrent].pid)
+            poolGive(r0, (void*)*(psp+1));
+        break;
     case MEMINFO:
     {
         uint8_t i;
@@ -724,25 +1818,96 @@ void svCallIsr(void)
             putsUart0("----------------------------------------------------------------\n");
             if (tcb[i].state != STATE_STOPPED)
             {
+                uint32_t peak = stackPeak(i);
                 putsUart0(tcb[i].name); putsUart0("    \t");
                 putsUart0(numToStr(tcb[i].size, info)); putsUart0(" B    \t0x"); putsUart0(uint32ToHexString((uint32_t*)&tcb[i].pid, info));
                 putsUart0("    \t0x"); putsUart0(uint32ToHexString((uint32_t*)&tcb[i].spInit, info)); putsUart0("\n");
+                putsUart0("    \tstack peak "); putsUart0(numToStr(peak, info));
+                putsUart0(" B, recommended "); putsUart0(numToStr(stackRecommended(peak), info)); putsUart0(" B");
+                if (tcb[i].guard)
+                {
+                    putsUart0(", guard "); putsUart0(numToStr(tcb[i].guard, info)); putsUart0(" B");
+                }
+                putsUart0("\n");
+                if (kdata.task[i].subheap)
+                {
+                    SUBHEAP* heap = (SUBHEAP*)kdata.task[i].subheap;
+                    uint8_t c;
+                    putsUart0("    \tsub-heap 0x"); putsUart0(uint32ToHexString((uint32_t*)&kdata.task[i].subheap, info));
+                    putsUart0(", blocks in use (peak)");
+                    for (c = 0; c < SUBHEAP_CLASSES; c++)
+                    {
+                        putsUart0(" "); putsUart0(numToStr(SUBHEAP_MIN << c, info)); putsUart0(":");
+                        putsUart0(numToStr(heap->used[c], info)); putsUart0("("); putsUart0(numToStr(heap->peak[c], info)); putsUart0(")");
+                    }
+                    putsUart0("\n");
+                }
 
                 uint8_t j;
-                for (j = 0; j < MAX_MEMORY_ALLOCATION; j++)
+                for (j = taskAllocations[i]; j != NO_ALLOCATION; j = allocatedData[j].next)
                 {
-                    if (tcb[i].pid == allocatedData[j].fnPid)
+                    uint32_t base = subregionAddress(allocatedData[j].start);
+                    putsUart0("    \t\t"); putsUart0(numToStr(allocatedData[j].size, info));
+                    putsUart0(" B    \t0x"); putsUart0(uint32ToHexString((uint32_t*)&tcb[i].pid, info)); putsUart0("    \t0x");
+                    putsUart0(uint32ToHexString(&base, info)); putsUart0("\n");
+                }
+            }
+        }
+        printHeapStats();
+        for (i = 0; i < MAX_POOLS; i++)
+        {
+            if (pools[i].inUse)
+            {
+                putsUart0("Pool "); putsUart0(pools[i].name); putsUart0(" \t");
+                putsUart0(numToStr(pools[i].blocks, info)); putsUart0(" x "); putsUart0(numToStr(pools[i].blockSize, info));
+                putsUart0(" B, used "); putsUart0(numToStr(pools[i].used, info));
+                putsUart0(", peak "); putsUart0(numToStr(pools[i].peak, info));
+                putsUart0(", failed "); putsUart0(numToStr(pools[i].failed, info)); putsUart0("\n");
+            }
+        }
+        for (i = 0; i < MAX_SHARES; i++)
+        {
+            if (shares[i].inUse)
+            {
+                uint8_t j;
+                putsUart0("Share "); putsUart0(shares[i].name); putsUart0(" \t");
+                putsUart0(numToStr(shares[i].size, info)); putsUart0(" B at 0x"); putsUart0(uint32ToHexString(&shares[i].base, info));
+                putsUart0(", owner "); putsUart0(tcb[shares[i].owner].name);
+                for (j = 0; j < MAX_TASKS; j++)
+                {
+                    if (shareGrantees(i) & (1 << j))
                     {
-                        putsUart0("    \t\t"); putsUart0(numToStr(allocatedData[j].size, info));
-                        putsUart0(" B    \t0x"); putsUart0(uint32ToHexString((uint32_t*)&tcb[i].pid, info)); putsUart0("    \t0x");
-                        putsUart0(uint32ToHexString((uint32_t*)&allocatedData[j].heapAddr, info)); putsUart0("\n");
+                        putsUart0((shares[i].writers & (1 << j)) ? ", rw " : ", r ");
+                        putsUart0(tcb[j].name);
                     }
                 }
+                putsUart0("\n");
             }
         }
-        putsUart0("Free space ");
-        putsUart0(numToStr(getFreeSpace(), info));
-        putsUart0(" B of 28672 B\n\n");
+        static char* oomPolicyNames[] = {"none", "lowest", "largest"};
+        putsUart0("OOM policy "); putsUart0(oomPolicyNames[oomPolicy]);
+        putsUart0(", pressure events "); putsUart0(numToStr(pressureEvents, info));
+        putsUart0(", oom kills "); putsUart0(numToStr(oomKills, info));
+        putsUart0(", reclaimers");
+        for (i = 0; i < taskCount; i++)
+        {
+            if (reclaimBits[i])
+            {
+                putsUart0(" "); putsUart0(tcb[i].name);
+            }
+        }
+        putsUart0("\n");
+        uint32_t kill;
+        for (kill = (oomKills > OOM_LOG_SIZE) ? oomKills - OOM_LOG_SIZE : 0; kill < oomKills; kill++)
+        {
+            OOM_RECORD* record = &oomLog[kill % OOM_LOG_SIZE];
+            putsUart0("oom: killed "); putsUart0(tcb[record->victim].name);
+            putsUart0(" ("); putsUart0(numToStr(record->footprint, info)); putsUart0(" B) for ");
+            putsUart0(tcb[record->requester].name);
+            putsUart0(" asking "); putsUart0(numToStr(record->size, info));
+            putsUart0(" B at tick "); putsUart0(numToStr(record->tick, info)); putsUart0("\n");
+        }
+        putsUart0("\n");
     }
         break;
     case REBOOT:
@@ -756,12 +1921,7 @@ void svCallIsr(void)
         {
             if (pid == tcb[i].pid && tcb[i].state == STATE_STOPPED)
             {
-                tcb[i].spInit = (void*)((uint32_t)mallocFromHeap(tcb[i].size) + tcb[i].size);
-                tcb[i].sp = tcb[i].spInit;
-                tcb[i].sp = runFn(tcb[i].sp, tcb[i].pid);
-                tcb[i].state = STATE_READY;
-                tcb[i].srd = createNoSramAccessMask();
-                addSramAccessWindow(&(tcb[i].srd), (uint32_t*)((uint32_t)tcb[i].spInit - tcb[i].size), tcb[i].size);
+                restartTask(i);
                 break;
             }
         }
@@ -775,12 +1935,7 @@ void svCallIsr(void)
         {
             if (pid == tcb[i].pid && STATE_STOPPED == tcb[i].state)
             {
-                tcb[i].spInit = (void*)((uint32_t)mallocFromHeap(tcb[i].size) + tcb[i].size);
-                tcb[i].sp = tcb[i].spInit;
-                tcb[i].sp = runFn(tcb[i].sp, tcb[i].pid);
-                tcb[i].state = STATE_READY;
-                tcb[i].srd = createNoSramAccessMask();
-                addSramAccessWindow(&(tcb[i].srd), (uint32_t*)((uint32_t)tcb[i].spInit - tcb[i].size), tcb[i].size);
+                restartTask(i);
                 break;
             }
         }
@@ -802,23 +1957,182 @@ void svCallIsr(void)
         }
     }
         break;
+    case SETFLAGS:
+    {
+        uint32_t r1 = *(psp+1);
+        if (r0 >= MAX_FLAG_GROUPS)
+            break;
+        if (flagsSet(r0, r1))
+            NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;
+    }
+        break;
+    case WAITFLAGS:
+    {
+        uint32_t r1 = *(psp+1);
+        uint32_t match;
+        *psp = 0;
+        if (r0 >= MAX_FLAG_GROUPS)
+            break;
+        match = flagGroups[r0].flags & r1;
+        if (match)
+        {
+            flagGroups[r0].flags &= ~match;
+            *psp = match;
+        }
+        else if (flagGroups[r0].queueSize < MAX_FLAG_QUEUE_SIZE)
+        {
+            tcb[taskCurrent].flagMask = r1;
+            tcb[taskCurrent].state = STATE_BLOCKED_FLAGS;
+            flagGroups[r0].processQueue[flagGroups[r0].queueSize++] = taskCurrent;
+            NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;
+        }
+    }
+        break;
+    case NOTIFY:
+    {
+        uint32_t r1 = *(psp+1);
+        uint8_t task = taskIndexOf((void*)r0);
+        if (task < MAX_TASKS && notifyGive(task, r1))
+            NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;
+    }
+        break;
+    case NOTIFY_WAIT:
+        if (tcb[taskCurrent].notifyValue)
+        {
+            *psp = tcb[taskCurrent].notifyValue;
+            tcb[taskCurrent].notifyValue = 0;
+        }
+        else
+        {
+            tcb[taskCurrent].state = STATE_BLOCKED_NOTIFY;
+            NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;
+        }
+        break;
+    case Q_SEND:
+    {
+        uint32_t r1 = *(psp+1);
+        bool woken = false;
+        uint32_t basepri;
+        *psp = false;
+        if (r0 >= MAX_QUEUES)
+            break;
+        basepri = enterCritical();              // ISR senders share the queue
+        *psp = queuePut(r0, r1, &woken);
+        leaveCritical(basepri);
+        if (woken)
+            NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;
+    }
+        break;
+    case Q_RECV:
+    {
+        uint32_t message;
+        uint32_t basepri;
+        bool ok;
+        if (r0 >= MAX_QUEUES)
+        {
+            *psp = 0;
+            break;
+        }
+        basepri = enterCritical();
+        ok = ringGetRecord(&queues[r0].ring, &message);
+        if (ok)
+            *psp = message;
+        else if (queues[r0].queueSize < MAX_QUEUE_WAIT_SIZE)
+        {
+            tcb[taskCurrent].state = STATE_BLOCKED_QUEUE;
+            queues[r0].processQueue[queues[r0].queueSize++] = taskCurrent;
+            NVIC_INT_CTRL_R |= NVIC_INT_CTRL_PEND_SV;
+        }
+        else
+            *psp = 0;
+        leaveCritical(basepri);
+    }
+        break;
+    case LATENCY:   // r0 is LATENCY_SHOW, LATENCY_START, LATENCY_STOP or LATENCY_RESET
+        if (r0 == LATENCY_START)
+            startLatencyTest();
+        else if (r0 == LATENCY_STOP)
+            stopLatencyTest();
+        else if (r0 == LATENCY_RESET)
+            resetLatency();
+        else
+            printLatency();
+        break;
+    case IRQSTAT:   // r0 true to clear the counters
+        if (r0)
+            resetIrqStats();
+        else
+            printIrqStats();
+        break;
+    case WORK_FETCH: // r0 has the worker's item buffer, r1 the batch size
+    {
+        uint32_t r1 = *(psp+1);
+        if (r1 > WORK_BATCH)
+            r1 = WORK_BATCH;
+        if (isTaskBuffer(taskCurrent, r0, r1 * sizeof(WORK_ITEM), true))
+            *psp = takeWork((WORK_ITEM*)r0, r1);
+        else
+            *psp = 0;
+    }
+        break;
+    case TRACE:     // r0 is TRACE_STOP, TRACE_START or TRACE_DUMP
+        if (r0 == TRACE_START)
+        {
+            if (!traceStart())
+                putsUart0("trace: no memory for buffer\n");
+        }
+        else if (r0 == TRACE_DUMP)
+            *psp = traceRewind();
+        else if (r0 == TRACE_READ)
+        {
+            uint32_t max = *(psp+2);
+            if (max > TRACE_CHUNK)
+                max = TRACE_CHUNK;
+            *psp = isTaskBuffer(taskCurrent, *(psp+1), max * sizeof(TRACE_EVENT), true)
+                    ? traceRead((TRACE_EVENT*)*(psp+1), max) : 0;
+        }
+        else if (r0 == TRACE_NAME)
+        {
+            uint32_t task = *(psp+2);
+            bool ok = task < taskCount && isTaskBuffer(taskCurrent, *(psp+1), NAME_SIZE, true);
+            if (ok)
+                strCpy(tcb[task].name, (char*)*(psp+1));
+            *psp = ok;
+        }
+        else
+            traceStop();
+        break;
+    case PROF:      // r0 is PROF_STOP, PROF_START, PROF_REPORT or PROF_DUMP
+        if (r0 == PROF_START)
+        {
+            if (!profStart())
+                putsUart0("prof: no memory for bins\n");
+        }
+        else if (r0 == PROF_REPORT || r0 == PROF_DUMP)
+            profReport(r0 == PROF_DUMP);
+        else
+            profStop();
+        break;
     case PS:        // r0 have the address of ps struct
     {
         PS_DATA* psInfo = (PS_DATA*)r0;
         uint8_t i,j;
-        uint32_t totalTime = 0;
-        for (j = 0; j < taskCount; j++)
-            if (pingPong == false)
-                totalTime += tcb[j].clockB;
-            else
-                totalTime += tcb[j].clockA;
+        if (!isTaskBuffer(taskCurrent, r0, taskCount * sizeof(PS_DATA), true))
+            break;
+        // raw fixed point only, the shell does the scaling so no float in handler mode
         for (i = 0; i < taskCount; i++)
         {
             psInfo[i].isData = true;
             strCpy(tcb[i].name, psInfo[i].taskName);
-            uint32_t taskTime = (pingPong == false) ? tcb[i].clockB : tcb[i].clockA;
-
-            psInfo[i].cpuPercent = ((float)taskTime / totalTime) * 10000;
+            foldTaskLoad(i);
+            for (j = 0; j < LOAD_WINDOWS; j++)
+                psInfo[i].load[j] = tcb[i].load[j];
+            psInfo[i].runCycles = tcb[i].cycles;
+            if (tcb[i].state != STATE_STOPPED)
+                psInfo[i].stackPeak = stackPeak(i);
+            else
+                psInfo[i].stackPeak = 0;
+            psInfo[i].stackRecommended = stackRecommended(psInfo[i].stackPeak);
             psInfo[i].memory = (uint16_t) tcb[i].size;
             uint8_t taskState = tcb[i].state;
             switch (taskState)
@@ -841,6 +2155,18 @@ void svCallIsr(void)
             case STATE_STOPPED:
                 strCpy("STOPPED          ", psInfo[i].state);
                 break;
+            case STATE_BLOCKED_FLAGS:
+                strCpy("BLOCKED_FLAGS    ", psInfo[i].state);
+                break;
+            case STATE_BLOCKED_NOTIFY:
+                strCpy("BLOCKED_NOTIFY   ", psInfo[i].state);
+                break;
+            case STATE_BLOCKED_QUEUE:
+                strCpy("BLOCKED_QUEUE    ", psInfo[i].state);
+                break;
+            case STATE_BLOCKED_MEMORY:
+                strCpy("BLOCKED_MEMORY   ", psInfo[i].state);
+                break;
             }
             if (taskState == STATE_BLOCKED_MUTEX)
             {
@@ -869,6 +2195,12 @@ void svCallIsr(void)
                 case flashReq:
                     strCpy("flashReq   ", psInfo[i].semaphore);
                     break;
+                case keyDown:
+                    strCpy("keyDown    ", psInfo[i].semaphore);
+                    break;
+                case workReady:
+                    strCpy("workReady  ", psInfo[i].semaphore);
+                    break;
                 default:
                     strCpy("N/A        ", psInfo[i].semaphore);
                     break;
@@ -880,6 +2212,9 @@ void svCallIsr(void)
     }
         break;
     }
+    // caller left ready in this call, a task switch is already pending
+    if (tcb[caller].state != callerState && tcb[caller].state != STATE_READY)
+        traceEvent(TRACE_BLOCK, caller, tcb[caller].state);
 
 
 /** next cmd is a problem because, GCC PUSH register(s) on fnc calls
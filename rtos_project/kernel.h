@@ -31,11 +31,36 @@ typedef void (*_fn)();
 #define resource 0
 
 // semaphore
-#define MAX_SEMAPHORES 3
+#define MAX_SEMAPHORES 5
 #define MAX_SEMAPHORE_QUEUE_SIZE 2
 #define keyPressed 0
 #define keyReleased 1
 #define flashReq 2
+#define keyDown 3
+#define workReady 4
+
+// event flags
+#define MAX_FLAG_GROUPS 2
+#define MAX_FLAG_QUEUE_SIZE 2
+
+// message queues, 32 bit messages
+#define MAX_QUEUES 2
+#define MAX_QUEUE_RECORDS 8            // power of two
+#define MAX_QUEUE_WAIT_SIZE 2
+
+// NVIC priority layering, 3 bits, 0 is highest
+//   0-1  zero latency, above BASEPRI so never masked, must not call the kernel
+//   2    SVC and SysTick, kernel critical sections raise BASEPRI to this level
+//   3-6  kernel aware interrupts, may call the FromIsr services
+//   7    PendSV, so a task switch only runs after every other handler is done
+#define ZERO_LATENCY_INT_PRIORITY 1
+#define KERNEL_INT_PRIORITY 2
+#define PENDSV_INT_PRIORITY 7
+
+// cpu load averages over 1, 10 and 60 s, fixed point with LOAD_FIXED_1 = 100%
+#define LOAD_WINDOWS 3
+#define LOAD_FSHIFT 11
+#define LOAD_FIXED_1 (1 << LOAD_FSHIFT)
 
 // MAX char in name
 #define NAME_SIZE 25
@@ -43,6 +68,18 @@ typedef void (*_fn)();
 // tasks
 #define MAX_TASKS 12
 
+// or'd into createThread stackBytes, the lowest subregion of the stack
+// allocation is left without access so an overflow faults instead of running
+// into the allocation below
+#define STACK_GUARD 0x80000000
+
+// memory pressure, mallocWait timeout that never expires and the oom policies,
+// lowest kills the lowest priority task, largest the one holding most memory
+#define MEM_WAIT_FOREVER 0xFFFFFFFF
+#define OOM_NONE 0
+#define OOM_KILL_LOWEST 1
+#define OOM_KILL_LARGEST 2
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -58,6 +95,11 @@ void restartThread(_fn fn);
 void stopThread(_fn fn);
 void setThreadPriority(_fn fn, uint8_t priority);
 void mallocRequest(uint32_t size, void** address);
+void freeRequest(void* address);
+void* reallocRequest(void* address, uint32_t size);
+void* mallocWait(uint32_t size, uint32_t timeout);
+void setMemoryPressure(uint32_t bits, bool exempt);
+void setOomPolicy(uint8_t policy);
 
 void yield(void);
 void sleep(uint32_t tick);
@@ -65,6 +107,28 @@ void lock(int8_t mutex);
 void unlock(int8_t mutex);
 void wait(int8_t semaphore);
 void post(int8_t semaphore);
+bool initQueue(uint8_t queue);
+void setFlags(uint8_t group, uint32_t flags);
+uint32_t waitFlags(uint8_t group, uint32_t mask);
+void notify(_fn fn, uint32_t bits);
+uint32_t waitNotify(void);
+bool queueSend(uint8_t queue, uint32_t message);
+uint32_t queueReceive(uint8_t queue);
+
+// handler mode variants, only from interrupts at KERNEL_INT_PRIORITY or lower
+void postFromIsr(int8_t semaphore);
+void setFlagsFromIsr(uint8_t group, uint32_t flags);
+void notifyFromIsr(_fn fn, uint32_t bits);
+bool queueSendFromIsr(uint8_t queue, uint32_t message);
+
+uint32_t enterCritical(void);
+void leaveCritical(uint32_t basepri);
+
+// kernel side, privileged only
+char* taskNameOf(uint8_t task);
+uint8_t taskOfStack(uint32_t address);
+uint32_t taskStackTop(uint8_t task);
+void killFaultingTask(uint8_t task);
 
 void systickIsr(void);
 void pendSvIsr(void);
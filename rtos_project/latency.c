@@ -0,0 +1,142 @@
+// Interrupt latency functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Hardware configuration:
+// Timer 1A - kernel aware interrupt class (masked in kernel critical sections)
+// Timer 2A - zero latency interrupt class (above BASEPRI, never masked)
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "latency.h"
+#include "kernel.h"
+#include "nvic.h"
+#include "vtable.h"
+#include "uart0.h"
+#include "c_fnc.h"
+
+// periods a few clocks off 1ms so the timeouts drift across systick,
+// svc and pendsv instead of always landing at the same point
+#define KERNEL_TEST_PERIOD 39989
+#define ZERO_TEST_PERIOD   40009
+
+typedef struct _LATENCY
+{
+    uint32_t count;                // interrupts measured
+    uint32_t last;                 // clocks from timeout to first isr read
+    uint32_t max;                  // worst case since last reset
+} LATENCY;
+
+LATENCY kernelLatency, zeroLatency;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// timers are configured and attached but left off, the 2 kHz of test
+// interrupts only run between latency start and latency stop
+void initLatencyTest(void)
+{
+    // Enable clocks
+    SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R1 | SYSCTL_RCGCTIMER_R2;
+    _delay_cycles(3);
+
+    // Configure Timer 1 and 2 as periodic count down timers
+    TIMER1_CTL_R  &= ~TIMER_CTL_TAEN;                // turn-off timer before reconfiguring
+    TIMER1_CFG_R   = TIMER_CFG_32_BIT_TIMER;         // configure as 32-bit timer (A+B)
+    TIMER1_TAMR_R  = TIMER_TAMR_TAMR_PERIOD;         // configure for periodic mode (count down)
+    TIMER1_TAILR_R = KERNEL_TEST_PERIOD;             // set load value (~1 kHz rate)
+    TIMER1_IMR_R   = TIMER_IMR_TATOIM;               // turn-on interrupt
+
+    TIMER2_CTL_R  &= ~TIMER_CTL_TAEN;
+    TIMER2_CFG_R   = TIMER_CFG_32_BIT_TIMER;
+    TIMER2_TAMR_R  = TIMER_TAMR_TAMR_PERIOD;
+    TIMER2_TAILR_R = ZERO_TEST_PERIOD;
+    TIMER2_IMR_R   = TIMER_IMR_TATOIM;
+
+    // attached without the counting wrapper, it would add its own clocks
+    // before the isr reads the timer
+    attachIsr(INT_TIMER1A, kernelLatencyIsr, false);
+    attachIsr(INT_TIMER2A, zeroLatencyIsr, false);
+    setNvicInterruptPriority(INT_TIMER1A, KERNEL_INT_PRIORITY + 1);
+    setNvicInterruptPriority(INT_TIMER2A, ZERO_LATENCY_INT_PRIORITY);
+    enableNvicInterrupt(INT_TIMER1A);
+    enableNvicInterrupt(INT_TIMER2A);
+    resetLatency();
+}
+
+void startLatencyTest(void)
+{
+    resetLatency();
+    TIMER1_CTL_R  |= TIMER_CTL_TAEN;                 // turn-on timers
+    TIMER2_CTL_R  |= TIMER_CTL_TAEN;
+}
+
+void stopLatencyTest(void)
+{
+    TIMER1_CTL_R  &= ~TIMER_CTL_TAEN;
+    TIMER2_CTL_R  &= ~TIMER_CTL_TAEN;
+    TIMER1_ICR_R   = TIMER_ICR_TATOCINT;             // drop a timeout already pending
+    TIMER2_ICR_R   = TIMER_ICR_TATOCINT;
+}
+
+void resetLatency(void)
+{
+    kernelLatency.count = kernelLatency.last = kernelLatency.max = 0;
+    zeroLatency.count = zeroLatency.last = zeroLatency.max = 0;
+}
+
+static void updateLatency(LATENCY* latency, uint32_t elapsed)
+{
+    latency->count++;
+    latency->last = elapsed;
+    if (elapsed > latency->max)
+        latency->max = elapsed;
+}
+
+// timer reloaded to TAILR at timeout and kept counting down, so the clocks
+// since the timeout are TAILR - TAV, read before anything else in the isr
+void kernelLatencyIsr(void)
+{
+    uint32_t elapsed = TIMER1_TAILR_R - TIMER1_TAV_R;
+    TIMER1_ICR_R = TIMER_ICR_TATOCINT;
+    updateLatency(&kernelLatency, elapsed);
+}
+
+void zeroLatencyIsr(void)
+{
+    uint32_t elapsed = TIMER2_TAILR_R - TIMER2_TAV_R;
+    TIMER2_ICR_R = TIMER_ICR_TATOCINT;
+    updateLatency(&zeroLatency, elapsed);
+}
+
+static void printLatencyLine(char name[], LATENCY* latency)
+{
+    char str[12];
+    putsUart0(name);
+    putsUart0(numToStr(latency->max, str)); putsUart0(" clk (");
+    putsUart0(numToStr(latency->max * 25, str)); putsUart0(" ns)\t last ");
+    putsUart0(numToStr(latency->last, str)); putsUart0(" clk\t samples ");
+    putsUart0(numToStr(latency->count, str)); putcUart0('\n');
+}
+
+// privileged, called from the svc
+void printLatency(void)
+{
+    putsUart0("----Worst Case Interrupt Latency----\n");
+    if (!(TIMER1_CTL_R & TIMER_CTL_TAEN))
+        putsUart0("test stopped, latency start to measure\n");
+    printLatencyLine("kernel aware (Timer1A) max ", &kernelLatency);
+    printLatencyLine("zero latency (Timer2A) max ", &zeroLatency);
+}
@@ -0,0 +1,38 @@
+// Interrupt latency functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Hardware configuration:
+// Timer 1A - kernel aware interrupt class (masked in kernel critical sections)
+// Timer 2A - zero latency interrupt class (above BASEPRI, never masked)
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+
+// shell commands, passed in r0 of the latency svc
+#define LATENCY_SHOW  0
+#define LATENCY_START 1
+#define LATENCY_STOP  2
+#define LATENCY_RESET 3
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initLatencyTest(void);
+void startLatencyTest(void);
+void stopLatencyTest(void);
+void resetLatency(void);
+void printLatency(void);
+void kernelLatencyIsr(void);
+void zeroLatencyIsr(void);
+
+#endif
@@ -14,156 +14,204 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+// the host build (tools/mmhost) swaps the MPU registers for plain variables
+#ifdef HOST_SIM
+#include "mpu_sim.h"
+#else
 #include "tm4c123gh6pm.h"
+#endif
 #include "mm.h"
+#include "kdata.h"
+#include "trace.h"
 
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
-void calculateBlockRequired(uint32_t requestedSize, uint8_t* blockCount1024, uint8_t* blockCount512);
-bool findConsecutiveSpace(uint8_t* allocatedIndex, uint8_t* needed1024Blocks, uint8_t* needed512Blocks);
-void getMallocAddr(uint16_t* subregion, uint16_t* region, uint8_t allocatedIndex);
+bool findSpace(uint32_t size, uint8_t* startIndex, uint8_t* endIndex);
+uint16_t subregionSizeAt(uint8_t index);
 uint8_t calculateIndex(uint32_t* baseAddrValue, uint16_t* subregionSize);
-void addAllocation(uint32_t size, void* heapAddr, void* pid);
-
-// Design specific data
-#define HEAP_ADDRESS 0x20001000     // base address for tasks space 28KB
-#define TOTAL_SPACE 28672
-#define MAX_1536B_BLOCK 3
-#define MAX_1024B_BLOCK 16
-#define MAX_512B_BLOCK 24
-#define MAX_ALLOCATION 14
-
-//***************************************************************************************************************
-// 63:56 - Sum of 1536B blocks used of 4-MAX
-// 55:48 - Sum of 1024B blocks used of 16-MAX
-// 47:40 - Sum of 512B blocks used of 24-MAX
-//  39:0 - each bit (0 - not in use, 1 - in use) represents a respected sub-region (0 being region at base addr)
-// **************************************************************************************************************
-uint64_t subregionUseData = 0;
-uint16_t usedSpace = 0;
+bool addAllocation(uint32_t size, uint8_t start);
+uint8_t findAllocation(void* base);
+
+// heap regions in address order, entry n is MPU region n + 3 and owns srd
+// bits 8 * (n + 1) to 8 * (n + 1) + 7, so the bit number of a subregion is its
+// place in the srd mask and in heapInUse
+// the plan comes from the linker command file through tools/heapplan.py, see
+// heapplan.h, a board with more SRAM only needs the header regenerated, it
+// gets larger subregions rather than more, see the limits in heapplan.py
+typedef struct _HEAP_REGION
+{
+    uint32_t base;
+    uint32_t size;                  // MPU regions are a power of two, aligned to their size
+    uint16_t subregionSize;         // size / 8
+    uint8_t  mpuRegion;
+    uint8_t  firstIndex;            // srd bit of subregion 0
+} HEAP_REGION;
+
+const HEAP_REGION heapRegions[NUM_HEAP_REGIONS] = HEAP_REGION_LIST;
+const uint32_t subregionSizes[NUM_SUBREGION_SIZES] = SUBREGION_SIZE_LIST;
+
+// bit n set while srd subregion n is allocated, an allocation's bits are the
+// window addSramAccessWindow opens
+uint64_t heapInUse = 0;
+uint32_t usedSpace = 0;             // bytes of whole subregions in use
+uint32_t requestedSpace = 0;        // bytes asked for by the live allocations
+uint32_t heapReleases = 0;          // bumped when subregions go back, allocation waiters retry on a change
+uint32_t allocFailures[ALLOC_FAIL_REASONS];
+uint32_t requestHistogram[HEAP_HISTOGRAM_BUCKETS];
+
+// registry, records are reached through byBase, kept sorted on base address so
+// a lookup is a binary search, unused records are chained from freeRecord
+MALLOC_DATA allocatedData[MAX_MEMORY_ALLOCATION];
+uint8_t byBase[MAX_MEMORY_ALLOCATION];
+uint8_t allocationCount = 0;
+uint8_t freeRecord = NO_ALLOCATION;
+uint8_t taskAllocations[MAX_TASKS];
 
 // REQUIRED: add your malloc code here and update the SRD bits for the current thread
 void * mallocFromHeap(uint32_t size_in_bytes)
 {
-    uint8_t* inUse1536 = (uint8_t*)(&subregionUseData) + 7; // 63:56 of inUse chances
-    uint8_t* inUse1024 = (uint8_t*)(&subregionUseData) + 6; // 55:48 of inUse blocks
-    uint8_t* inUse512  = (uint8_t*)(&subregionUseData) + 5; // 47:40 of inUse blocks
-
-    bool ok = 0;
-    uint8_t needed1024Blocks, needed512Blocks;
-    calculateBlockRequired(size_in_bytes, &needed1024Blocks, &needed512Blocks);
-
-    uint8_t totalSpaceNeeded = needed1024Blocks*2 + needed512Blocks; // Space respect to 512B block
-    uint8_t block1024Avaliable = MAX_1024B_BLOCK - (*inUse1024);
-    uint8_t block512Avaliable = MAX_512B_BLOCK - (*inUse512);
-
-    // max allocation limit to 8KB
-    if((totalSpaceNeeded > (block1024Avaliable*2 + block512Avaliable)) || totalSpaceNeeded > 16)
-        return 0;    // all blocks used
-
-    // confirms block availability, not the consecutiveness so many if's in next block
-    if((needed1024Blocks > block1024Avaliable) && (totalSpaceNeeded <= block512Avaliable))
-    {
-        needed512Blocks = totalSpaceNeeded;     // not enough 1024B, assign multiple 512B
-        needed1024Blocks = 0;                   // transfered to 512B block
-    }
-    else if((needed512Blocks > block512Avaliable) && ((needed1024Blocks + 1) <= block1024Avaliable))
-    {
-        needed512Blocks = 0;                // transfered to 1024B block
-        needed1024Blocks += 1;              // Calculating fnc returns max 1 512B block
-    }
-
+    uint8_t startIndex, endIndex;
+    uint64_t mask;
     void* addrPtr;
-    uint8_t allocatedIndex = 0;
-    if((needed1024Blocks == 1) && (needed512Blocks == 1)) // 1536B needed, special case
+    uint8_t bucket = 0;
+
+    while (bucket < HEAP_HISTOGRAM_BUCKETS - 1 && size_in_bytes > ((uint32_t)64 << bucket))
+        bucket++;
+    requestHistogram[bucket]++;
+    if (size_in_bytes == 0 || size_in_bytes > HEAP_SIZE)
     {
-        if(*inUse1536 < MAX_1536B_BLOCK)
-            ok = findConsecutiveSpace(&allocatedIndex, &needed1024Blocks, &needed512Blocks);
-        if(!ok)     // space not found
-        {
-            needed1024Blocks = 0;
-            needed512Blocks = 3;    // on unavailability of edge regions, allocate multiple 512B
-            ok = findConsecutiveSpace(&allocatedIndex, &needed1024Blocks, &needed512Blocks);
-        }
-        if(!ok)     // space not found
-        {
-            needed1024Blocks = 2;   // allocate multiple 1024B, waste space
-            needed512Blocks = 0;
-            ok = findConsecutiveSpace(&allocatedIndex, &needed1024Blocks, &needed512Blocks);
-        }
+        allocFailures[ALLOC_FAIL_SIZE]++;
+        return 0;
     }
-    else
+    if (!findSpace(size_in_bytes, &startIndex, &endIndex))
     {
-        if(needed1024Blocks != 0)       // multiple of 1024B
-        {
-            ok = findConsecutiveSpace(&allocatedIndex, &needed1024Blocks, &needed512Blocks);
-            if(!ok)     // unavailability on 8KB block
-            {
-                needed512Blocks = totalSpaceNeeded;    // allocate multiples of 512B
-                needed1024Blocks = 0;
-                ok = findConsecutiveSpace(&allocatedIndex, &needed1024Blocks, &needed512Blocks);
-            }
-        }
-        else if(needed512Blocks != 0)        // multiple of 512B
-        {
-            ok = findConsecutiveSpace(&allocatedIndex, &needed1024Blocks, &needed512Blocks);
-            if(!ok)     // unavailability on 4KB block
-            {
-                needed512Blocks = 0;
-                needed1024Blocks = (totalSpaceNeeded % 2) ? (totalSpaceNeeded / 2) + 1 :
-                                    (totalSpaceNeeded / 2);  // allocate multiples of 1024B
-                ok = findConsecutiveSpace(&allocatedIndex, &needed1024Blocks, &needed512Blocks);
-            }
-        }
+        allocFailures[(getFreeSpace() < size_in_bytes) ? ALLOC_FAIL_NO_SPACE : ALLOC_FAIL_FRAGMENTED]++;
+        return 0;
     }
-
-    if(ok)
+    addrPtr = (void*)subregionAddress(startIndex);
+    if (!addAllocation(size_in_bytes, startIndex))
     {
-        uint16_t subregionAddr, regionAddr;
-        getMallocAddr(&subregionAddr, &regionAddr, allocatedIndex);
-        addrPtr = (void*)(HEAP_ADDRESS + regionAddr + subregionAddr);
-        addAllocation(totalSpaceNeeded * 512, (void*)((uint32_t)addrPtr+size_in_bytes), (void*)0x20008000);   // store stack top
-        return addrPtr;
+        allocFailures[ALLOC_FAIL_REGISTRY]++;
+        return 0;                   // registry full, nothing marked yet
     }
-    else    // sizeInBytes = 0
-        return 0;
+    mask = (((uint64_t)1 << (endIndex - startIndex)) - 1) << startIndex;
+    heapInUse |= mask;
+    usedSpace += subregionAddress(endIndex) - (uint32_t)addrPtr;
+    requestedSpace += size_in_bytes;
+    traceEvent(TRACE_MALLOC, kdata.taskCurrent, size_in_bytes);
+    return addrPtr;
 }
 
 // REQUIRED: add your free code here and update the SRD bits for the current thread
+// pMemory is the base address mallocFromHeap returned, an unknown or already
+// freed address is ignored
 void freeToHeap(void *pMemory)
 {
-    uint8_t* inUse1536 = (uint8_t*)(&subregionUseData) + 7; // 63:56 of inUse chances
-    uint8_t* inUse1024 = (uint8_t*)(&subregionUseData) + 6; // 55:48 of inUse blocks
-    uint8_t* inUse512  = (uint8_t*)(&subregionUseData) + 5; // 47:40 of inUse blocks
+    uint8_t at = findAllocation(pMemory);
+    uint8_t i, *link;
+    traceEvent(TRACE_FREE, kdata.taskCurrent, (uint32_t)pMemory);
+    if (at == NO_ALLOCATION)
+        return;
+    i = byBase[at];
+    uint32_t base = (uint32_t)pMemory;
+    uint32_t last = base + allocatedData[i].size - 1;
+    uint16_t subregionSize;
+    uint8_t startIndex = calculateIndex(&base, &subregionSize);
+    uint8_t endIndex = calculateIndex(&last, &subregionSize) + 1;
+    heapInUse &= ~((((uint64_t)1 << (endIndex - startIndex)) - 1) << startIndex);
+    usedSpace -= subregionAddress(endIndex) - subregionAddress(startIndex);
+    requestedSpace -= allocatedData[i].size;
+    heapReleases++;
+
+    if (allocatedData[i].owner != NO_OWNER)
+    {
+        link = &taskAllocations[allocatedData[i].owner];
+        while (*link != i)
+            link = &allocatedData[*link].next;
+        *link = allocatedData[i].next;
+    }
+    allocationCount--;
+    for (; at < allocationCount; at++)
+        byBase[at] = byBase[at + 1];
+    allocatedData[i].next = freeRecord;
+    freeRecord = i;
+}
 
-    uint8_t i;
-    for(i = 0; i < MAX_ALLOCATION; i++)
+// grows or shrinks an allocation without moving it, the base stays and only
+// the subregions at the top change, false if the ones above are not free
+bool resizeInHeap(void* base, uint32_t size_in_bytes)
+{
+    uint8_t at = findAllocation(base);
+    uint8_t i, endIndex, newEndIndex;
+    uint32_t last;
+    uint16_t subregionSize;
+    uint64_t mask;
+    if (at == NO_ALLOCATION || size_in_bytes == 0 || size_in_bytes > HEAP_END - (uint32_t)base)
+        return false;
+    i = byBase[at];
+    last = (uint32_t)base + allocatedData[i].size - 1;
+    endIndex = calculateIndex(&last, &subregionSize) + 1;
+    last = (uint32_t)base + size_in_bytes - 1;
+    newEndIndex = calculateIndex(&last, &subregionSize) + 1;
+    if (newEndIndex > endIndex)
     {
-        if (allocatedData[i].heapAddr == pMemory)
-            break;
+        mask = (((uint64_t)1 << (newEndIndex - endIndex)) - 1) << endIndex;
+        if (heapInUse & mask)
+            return false;
+        heapInUse |= mask;
+        usedSpace += subregionAddress(newEndIndex) - subregionAddress(endIndex);
     }
-    uint32_t sizeInBytes = allocatedData[i].size;
-    uint32_t baseAddrValue = (uint32_t)pMemory - sizeInBytes;
-    uint16_t startSubregionSize, endSubregionSize;
-    uint8_t startIndex = calculateIndex(&baseAddrValue, &startSubregionSize);
-    startIndex -= 8;    // heap don't include OS kernel
-    baseAddrValue += sizeInBytes - 1;
-    // need to the correct sub-region size by sending in region address
-    uint8_t endIndex = calculateIndex(&baseAddrValue, &endSubregionSize);
-    endIndex -= 8 - 1;      // need to include for bit shifts
-    subregionUseData &= ~((((uint64_t)1 << (endIndex - startIndex)) - 1) << startIndex);
-
-    // change inUse blocks
-    if((startSubregionSize == 512 && endSubregionSize == 1024) || (startSubregionSize == 1024 && endSubregionSize == 512))
+    else if (newEndIndex < endIndex)
     {
-        *inUse512 -= 1;
-        *inUse1024 -= 1;
-        *inUse1536 -= 1;
+        heapInUse &= ~((((uint64_t)1 << (endIndex - newEndIndex)) - 1) << newEndIndex);
+        usedSpace -= subregionAddress(endIndex) - subregionAddress(newEndIndex);
+        heapReleases++;
     }
-    else
-        *(startSubregionSize == 512 ? inUse512 : inUse1024) -= sizeInBytes / startSubregionSize;
-    usedSpace -= sizeInBytes;
+    requestedSpace += size_in_bytes;
+    requestedSpace -= allocatedData[i].size;
+    allocatedData[i].size = size_in_bytes;
+    traceEvent(TRACE_MALLOC, kdata.taskCurrent, size_in_bytes);
+    return true;
+}
+
+// puts the allocation on the task's list, so it is freed with the task
+bool setAllocationOwner(void* base, uint8_t task)
+{
+    uint8_t at = findAllocation(base);
+    uint8_t i;
+    if (at == NO_ALLOCATION || task >= MAX_TASKS)
+        return false;
+    i = byBase[at];
+    if (allocatedData[i].owner != NO_OWNER)
+        return allocatedData[i].owner == task;
+    allocatedData[i].owner = task;
+    allocatedData[i].next = taskAllocations[task];
+    taskAllocations[task] = i;
+    return true;
+}
+
+// NO_OWNER for kernel allocations and for addresses that are not a base
+uint8_t allocationOwner(void* base)
+{
+    uint8_t at = findAllocation(base);
+    return (at == NO_ALLOCATION) ? NO_OWNER : allocatedData[byBase[at]].owner;
+}
+
+// requested bytes, 0 if base is not an allocation
+uint32_t allocationSize(void* base)
+{
+    uint8_t at = findAllocation(base);
+    return (at == NO_ALLOCATION) ? 0 : allocatedData[byBase[at]].size;
+}
+
+// kill cleanup, only walks the task's own records
+void freeTaskAllocations(uint8_t task)
+{
+    if (task >= MAX_TASKS)
+        return;
+    while (taskAllocations[task] != NO_ALLOCATION)
+        freeToHeap((void*)subregionAddress(allocatedData[taskAllocations[task]].start));
 }
 
 // REQUIRED: include your solution from the mini project
@@ -193,6 +241,19 @@ void allowPeripheralAccess(void)
                         (0x00 << 8) | (0x1B << 1) | NVIC_MPU_ATTR_ENABLE;
 }
 
+void allowKernelDataAccess(void)
+{
+    // set region number (0 - 7)
+    NVIC_MPU_NUMBER_R = 0x2;
+    // set region base address (N=log2(Size)) and let it use MPUNUMBER (0<<4)
+        // region 2 : 0x20000F00 - 0x20000FFF , 8 = log2(256B), kernel data page
+    NVIC_MPU_BASE_R = (0x200000FU << 8) | (0 << 4) | (0 << 0);
+    // set region to NOT allow processor to fetch in exception, +r+w privilege and +r-w user,
+        // (tex-s-c-b) see pg.130, all sub-regions enable, size encoding pg.92 (N-1), enable the region
+    NVIC_MPU_ATTR_R = (1 << 28) | (0b010 << 24) | (0b000 << 19) | (1 << 18) | (1 << 17) | (0 << 16) |
+                        (0x00 << 8) | (0x7 << 1) | NVIC_MPU_ATTR_ENABLE;
+}
+
 void setupSramAccess(void)
 {
 /*    // 4KB OS Kernel, takes background region config (+r+w+x privilege, -r-w-x user)
@@ -206,56 +267,22 @@ void setupSramAccess(void)
     NVIC_MPU_ATTR_R = (0 << 28) | (0b011 << 24) | (0b000 << 19) | (1 << 18) | (1 << 17) | (0 << 16) |
                         (0xFF << 8) | (0xB << 1) | NVIC_MPU_ATTR_ENABLE;*/
 
-    // Heap for threads
-    // set region number (0 - 7)
-    NVIC_MPU_NUMBER_R = 0x3;
-    // set region base address (N=log2(Size)) and let it use MPUNUMBER (0<<4)
-        // region 0 : 0x20001000 - 0x20001FFF , 12 = log2(4KB)
-    NVIC_MPU_BASE_R = (0x20001 << 12) | (0 << 4) | (0 << 0);
-    // set region to allow processor to fetch in exception, +r+w user,
-        // (tex-s-c-b) see pg.130, all sub-regions disable, size encoding pg.92 (N-1), enable the region
-    NVIC_MPU_ATTR_R = (0 << 28) | (0b011 << 24) | (0b000 << 19) | (1 << 18) | (1 << 17) | (0 << 16) |
-                        (0xFF << 8) | (0xB << 1) | NVIC_MPU_ATTR_ENABLE;
-
-    // set region number (0 - 7)
-    NVIC_MPU_NUMBER_R = 0x4;
-    // set region base address (N=log2(Size)) and let it use MPUNUMBER (0<<4)
-        // region 0 : 0x20002000 - 0x20003FFF , 13 = log2(8KB)
-    NVIC_MPU_BASE_R = (0x10001 << 13) | (0 << 4) | (0 << 0);
-    // set region to allow processor to fetch in exception, +r+w user,
-        // (tex-s-c-b) see pg.130, all sub-regions disable, size encoding pg.92 (N-1), enable the region
-    NVIC_MPU_ATTR_R = (0 << 28) | (0b011 << 24) | (0b000 << 19) | (1 << 18) | (1 << 17) | (0 << 16) |
-                        (0xFF << 8) | (0xC << 1) | NVIC_MPU_ATTR_ENABLE;
-
-    // set region number (0 - 7)
-    NVIC_MPU_NUMBER_R = 0x5;
-    // set region base address (N=log2(Size)) and let it use MPUNUMBER (0<<4)
-        // region 0 : 0x20004000 - 0x20004FFF , 12 = log2(4KB)
-    NVIC_MPU_BASE_R = (0x20004 << 12) | (0 << 4) | (0 << 0);
-    // set region to allow processor to fetch in exception, +r+w user,
-        // (tex-s-c-b) see pg.130, all sub-regions disable, size encoding pg.92 (N-1), enable the region
-    NVIC_MPU_ATTR_R = (0 << 28) | (0b011 << 24) | (0b000 << 19) | (1 << 18) | (1 << 17) | (0 << 16) |
-                        (0xFF << 8) | (0xB << 1) | NVIC_MPU_ATTR_ENABLE;
-
-    // set region number (0 - 7)
-    NVIC_MPU_NUMBER_R = 0x6;
-    // set region base address (N=log2(Size)) and let it use MPUNUMBER (0<<4)
-        // region 0 : 0x20005000 - 0x20005FFF , 12 = log2(4KB)
-    NVIC_MPU_BASE_R = (0x20005 << 12) | (0 << 4) | (0 << 0);
-    // set region to allow processor to fetch in exception, +r+w user,
-        // (tex-s-c-b) see pg.130, all sub-regions disable, size encoding pg.92 (N-1), enable the region
-    NVIC_MPU_ATTR_R = (0 << 28) | (0b011 << 24) | (0b000 << 19) | (1 << 18) | (1 << 17) | (0 << 16) |
-                        (0xFF << 8) | (0xB << 1) | NVIC_MPU_ATTR_ENABLE;
-
-    // set region number (0 - 7)
-    NVIC_MPU_NUMBER_R = 0x7;
-    // set region base address (N=log2(Size)) and let it use MPUNUMBER (0<<4)
-        // region 0 : 0x20006000 - 0x20007FFF , 13 = log2(8KB)
-    NVIC_MPU_BASE_R = (0x10003 << 13) | (0 << 4) | (0 << 0);
-    // set region to allow processor to fetch in exception, +r+w user,
-        // (tex-s-c-b) see pg.130, all sub-regions disable, size encoding pg.92 (N-1), enable the region
-    NVIC_MPU_ATTR_R = (0 << 28) | (0b011 << 24) | (0b000 << 19) | (1 << 18) | (1 << 17) | (0 << 16) |
-                        (0x7F << 8) | (0xC << 1) | NVIC_MPU_ATTR_ENABLE;
+    // Heap for threads, one region per heap plan entry
+    uint8_t i;
+    for (i = 0; i < NUM_HEAP_REGIONS; i++)
+    {
+        uint8_t sizeBits = 0;
+        while (((uint32_t)2 << sizeBits) < heapRegions[i].size)
+            sizeBits++;                     // log2(size) - 1, the MPU size encoding
+        // set region number (0 - 7)
+        NVIC_MPU_NUMBER_R = heapRegions[i].mpuRegion;
+        // set region base address, the region is aligned to its size, use MPUNUMBER (0<<4)
+        NVIC_MPU_BASE_R = heapRegions[i].base | (0 << 4) | (0 << 0);
+        // set region to allow processor to fetch in exception, +r+w user,
+            // (tex-s-c-b) see pg.130, all sub-regions disable, size encoding pg.92 (N-1), enable the region
+        NVIC_MPU_ATTR_R = (0 << 28) | (0b011 << 24) | (0b000 << 19) | (1 << 18) | (1 << 17) | (0 << 16) |
+                            (0xFF << 8) | (sizeBits << 1) | NVIC_MPU_ATTR_ENABLE;
+    }
 }
 
 uint64_t createNoSramAccessMask(void)
@@ -267,29 +294,47 @@ uint64_t createNoSramAccessMask(void)
 
 void addSramAccessWindow(uint64_t *srdBitMask, uint32_t *baseAdd, uint32_t size_in_bytes)
 {
-    uint32_t baseAddrValue = (uint32_t)(baseAdd);
+    uint32_t base = (uint32_t)(baseAdd);
+    uint32_t last = base + size_in_bytes - 1;
     uint16_t subregionSize;
     uint8_t startIndex, endIndex;
 
-    startIndex = calculateIndex(&baseAddrValue, &subregionSize);
-    baseAddrValue += size_in_bytes;
-    if(baseAddrValue > 0x20008000)
-        return; // out of SRAM region
-    endIndex = calculateIndex(&baseAddrValue, &subregionSize);
-    if (size_in_bytes % 512) endIndex++;    // on not multiple of 512 add an additional index
+    if (size_in_bytes == 0 || base < HEAP_ADDRESS || last >= HEAP_END)
+        return; // out of the heap
+    startIndex = calculateIndex(&base, &subregionSize);
+    endIndex = calculateIndex(&last, &subregionSize) + 1;  // subregion holding the last byte is opened too
 
     (*srdBitMask) &= ~((((uint64_t)1 << (endIndex - startIndex)) - 1) << startIndex);
 }
 
+// true if the range is inside the heap and every subregion it touches is open
+// in the mask, the heap is the only SRAM a task is given
+bool sramWindowOpen(uint64_t srdBitMask, uint32_t address, uint32_t size_in_bytes)
+{
+    uint64_t window = createNoSramAccessMask();
+    if (size_in_bytes == 0 || address < HEAP_ADDRESS || size_in_bytes > HEAP_END - address)
+        return false;
+    addSramAccessWindow(&window, (uint32_t*)address, size_in_bytes);
+    return (srdBitMask & ~window) == 0;
+}
+
+// 512 or 1024, size of the heap subregion holding address, 0 outside the heap
+uint16_t subregionSizeOf(uint32_t address)
+{
+    uint16_t subregionSize = 0;
+    calculateIndex(&address, &subregionSize);
+    return subregionSize;
+}
+
 void applySramAccessMask(uint64_t srdBitMask)
 {
-    uint8_t i, j=0;
+    uint8_t i;
     // 0 and 1 region used for flash and peripherals, respectively
-        // 2 is OS Kernel....3-7 follows 4KB -> 8KB -> 4KB -> 4KB -> 8KB
-    for(i = 2; i < 8; i++)      // 6 iterations
+        // 2 is kernel data page (byte 0, OS Kernel, never granted), heap regions follow
+    for(i = 0; i < NUM_HEAP_REGIONS; i++)
     {
-        uint8_t regionSrdMask = (uint8_t)(srdBitMask >> (j*8));
-        NVIC_MPU_NUMBER_R = i;
+        uint8_t regionSrdMask = (uint8_t)(srdBitMask >> heapRegions[i].firstIndex);
+        NVIC_MPU_NUMBER_R = heapRegions[i].mpuRegion;
         // disable region before updating
         NVIC_MPU_ATTR_R &= ~NVIC_MPU_ATTR_ENABLE;
         // clear and assign srd mask to each sub-regions bit
@@ -297,182 +342,64 @@ void applySramAccessMask(uint64_t srdBitMask)
         NVIC_MPU_ATTR_R |= regionSrdMask << 8;
         // enable region after updating
         NVIC_MPU_ATTR_R |= NVIC_MPU_ATTR_ENABLE;
-        ++j;
     }
 }
 
-void calculateBlockRequired(uint32_t requestedSize, uint8_t* blockCount1024, uint8_t* blockCount512)
+uint16_t subregionSizeAt(uint8_t index)
 {
-    *blockCount1024 = 0;
-    *blockCount512 = 0;
-    *blockCount1024 = requestedSize / 1024;        // # of 1024Bblocks are needed
-    uint32_t remainingSize = requestedSize % 1024; // remaining size
-
-    // If there's any remaining size, calculate the number of 512-byte blocks needed
-    if(remainingSize > 0)
-    {
-        // if more than 1536B allocate multiple 1024B blocks, else do the special case
-        if(remainingSize > 512)
-            *blockCount1024 += 1; // if remains more than 512, allocate one more 1024B block
-        else
-        {
-            if(*blockCount1024 > 1)
-                *blockCount1024 += 1;
-            else
-                *blockCount512 = 1; // allocate 512B block for the remainder
-        }
-    }
+    return heapRegions[(index / 8) - 1].subregionSize;
 }
 
-void getMallocAddr(uint16_t* subregion, uint16_t* region, uint8_t allocatedIndex)
+// heap end for SRD_INDEX_END
+uint32_t subregionAddress(uint8_t index)
 {
-    *region = ((allocatedIndex / 8) * 0x1000);
-    if (allocatedIndex >= 16)
-        *region += 0x1000;  // skips 0x20003000 by adding
-
-    // sub-region address based on the block
-    if (allocatedIndex < 8 || (allocatedIndex >= 16 && allocatedIndex < 32))
-        *subregion = (allocatedIndex % 8) * 512;
-    else
-        *subregion = (allocatedIndex % 8) * 1024;
+    const HEAP_REGION* region;
+    if (index >= SRD_INDEX_END)
+        return HEAP_END;
+    region = &heapRegions[(index / 8) - 1];
+    return region->base + (index - region->firstIndex) * region->subregionSize;
 }
 
-bool findConsecutiveSpace(uint8_t* allocatedIndex, uint8_t* needed1024Blocks, uint8_t* needed512Blocks)
+// best fit over the runs of free subregions, a run is walked with two indexes,
+// so the search is bounded by twice the heap subregions whatever the heap holds,
+// the candidate wasting least to rounding wins, ties go to the smaller run so
+// large runs stay whole for stacks, end index is one past the last subregion
+bool findSpace(uint32_t size, uint8_t* startIndex, uint8_t* endIndex)
 {
-    bool found = 0;
-    uint8_t* inUse1536 = (uint8_t*)(&subregionUseData) + 7; // 63:56 of inUse chances
-    uint8_t* inUse1024 = (uint8_t*)(&subregionUseData) + 6; // 55:48 of inUse blocks
-    uint8_t* inUse512  = (uint8_t*)(&subregionUseData) + 5; // 47:40 of inUse blocks
-    uint8_t* block2InUse8KB = (uint8_t*)(&subregionUseData) + 4; //   |  8 KB  |   ' 0x20008000
-    uint8_t* block3InUse4KB = (uint8_t*)(&subregionUseData) + 3; //   |  4 KB  |   '
-    uint8_t* block2InUse4KB = (uint8_t*)(&subregionUseData) + 2; //   |  4 KB  |   '
-    uint8_t* block1InUse8KB = (uint8_t*)(&subregionUseData) + 1; //   |  8 KB  |   '
-    uint8_t* block1InUse4KB = (uint8_t*)(&subregionUseData);     //   |  4 KB  |   v 0x20001000
-
-    uint8_t i;
-    if((*needed1024Blocks == 1) && (*needed512Blocks == 1)) // 1536B multiple, special case
-    {
-        for(i = 1; i < 4; i++)
-        {
-            // region on edge of multiple of 8 and 4KB 8KB block alternates, so check one up and down
-            bool lowerRegionEdge = (bool) ((i == 1 || i == 2) ? (subregionUseData & (1 << ((i*8) - 1))) : (subregionUseData & ((uint64_t)1 << 31)));
-            bool upperRegionEdge = (bool) ((i == 1 || i == 2) ? (subregionUseData & (1 << (i*8))) : (subregionUseData & ((uint64_t)1 << 32)));
-            if(!lowerRegionEdge && !upperRegionEdge)
-            {
-                // space found, return allocatedIndex and found
-                found = 1;
-                (*inUse512)++;
-                (*inUse1024)++;
-                (*inUse1536)++;
-                subregionUseData |= (i == 1 || i == 2) ? (3 << ((i*8) - 1)) : ((uint64_t)3 << 31);     // marks upper and lower as 'in use'
-                *allocatedIndex = (i == 1 || i == 2) ? ((i*8)-1) : (31);  // assignment of lowerRegion in terms of index
-                return found;
-            }
-        }
-        return found;
-    }
-    else if(*needed1024Blocks != 0) // 1024B multiple
+    bool found = false;
+    uint32_t bestWaste = 0, bestRun = 0;
+    uint8_t i = SRD_INDEX_HEAP;
+    while (i < SRD_INDEX_END)
     {
-        uint8_t tryWithoutEdge; // for preserving edges for 1536
-        for(tryWithoutEdge = 0; tryWithoutEdge < 2; tryWithoutEdge++)
+        uint8_t runStart, runEnd, lo, hi;
+        uint32_t runBytes = 0, bytes = 0;
+        if (heapInUse & ((uint64_t)1 << i))
         {
-            // if checked once for space greater than 6 which is with edge sub-regions so there no space
-            if((tryWithoutEdge == 1) && (*needed512Blocks > 6))
-                return found;
-
-            for(i = 0; i < 2; i++)  // 2 8KB blocks
-            {
-                // only save edge sub-region in 8KB if 4KB edge is not used, shifting hard-coded by design
-                bool lower4kbRegionEdge = (bool)((i == 0) ? (subregionUseData & (1 << 7)) : (subregionUseData & ((uint64_t)1 << 31)));
-                bool upper4kbRegionEdge = (bool)((i == 0) ? (subregionUseData & (1 << 16)) : 0);    // second 8KB no upper edge
-
-                uint8_t* currentBlock8kb = (i == 0) ? block1InUse8KB : block2InUse8KB;
-                uint8_t j, count1024B = 0;
-                for(j = 0; j < 8; j++)  // 8 sub-regions in one 8KB block
-                {
-                    // saving edge sub-regions if less or equal to 6KB
-                        // when tryWithoutEdge = 1 space not found for 6KB or less needed, check with edge sub-regions (if not executes)
-                    if(!tryWithoutEdge && (*needed1024Blocks <= 6))
-                    {
-                        if((j==0) && !lower4kbRegionEdge) continue;
-                        else if((j==7) && !upper4kbRegionEdge) continue;
-                    }
-
-                    if(!(*currentBlock8kb & (1 << j)))  // for detecting continuity
-                        count1024B++;
-                    else    // reset if occupied
-                        count1024B = 0;
-
-                    if(count1024B == *needed1024Blocks) // found space
-                    {
-                        found = 1;
-                        int8_t k, startIndex = j - *needed1024Blocks + 1;
-                        for(k = j; k >= startIndex; k--)
-                        {
-                            (*inUse1024)++;
-                            // mark occupied
-                            *currentBlock8kb |= (1 << k);
-                        }
-                        // depending on which block, return the index
-                        *allocatedIndex = (i == 0) ? (8 + startIndex) : (32 + startIndex);
-                        return found;
-                    }
-                }
-            }
+            i++;
+            continue;
         }
-    }
-    else if(*needed512Blocks != 0) // 512B multiple
-    {
-        uint8_t tryWithoutEdge; // for preserving edges for 1536
-        for(tryWithoutEdge = 0; tryWithoutEdge < 2; tryWithoutEdge++)
+        runStart = i;
+        while (i < SRD_INDEX_END && !(heapInUse & ((uint64_t)1 << i)))
+            runBytes += subregionSizeAt(i++);
+        runEnd = i;
+        if (runBytes < size)
+            continue;
+        lo = runStart;
+        for (hi = runStart; hi < runEnd; hi++)
         {
-            uint8_t irr = 8;    // 8 sub-regions in one 4KB block
-            // if checked once for space greater than 10 which is with edge sub-regions so there no space
-            if ((tryWithoutEdge == 1) && (*needed512Blocks > 10))
-                return found;
-            else if ((*needed512Blocks > 8))
-                irr = 16;  // allow allocation over other 4K region
-
-            for(i = 0; i < 3; i++)  // 3 4KB blocks
+            bytes += subregionSizeAt(hi);
+            while (bytes - subregionSizeAt(lo) >= size)     // drop what is not needed at the low end
+                bytes -= subregionSizeAt(lo++);
+            if (bytes >= size)
             {
-                // only save edge sub-region in 4KB if 8KB edge is not used, shifting hard-coded by design
-                bool lower8kbRegionEdge = (bool) (subregionUseData & (1 << 15));
-                bool upper8kbRegionEdge = (bool)((i == 0) ? (subregionUseData & (1 << 8)) : (subregionUseData & ((uint64_t)1 << 32)));
-
-                // iterate through 4KB blocks
-                uint16_t* currentBlock4kb = (uint16_t*)((i == 0) ? block1InUse4KB :
-                                            (i == 1) ? block2InUse4KB : block3InUse4KB);
-                uint8_t j, count512B = 0;
-                for(j = 0; j < irr; j++)
+                uint32_t waste = bytes - size;
+                if (!found || waste < bestWaste || (waste == bestWaste && runBytes < bestRun))
                 {
-                    // saving edge sub-regions if less or equal to 3KB, design specific
-                        // when tryWithoutEdge = 1 space not found for 3KB or less needed, check with edge sub-regions
-                    if(!tryWithoutEdge && (*needed512Blocks <= 6))
-                    {
-                        if((j==7) && (i==2) && !upper8kbRegionEdge) continue;
-                        else if((j==0) && (i==1) && !lower8kbRegionEdge) continue;
-                        else if((j==7) && (i==0) && !upper8kbRegionEdge) continue;
-                    }
-
-                    if(!(*currentBlock4kb & (1 << j)))  // for detecting continuity
-                        count512B++;
-                    else    // reset if occupied
-                        count512B = 0;
-
-                    if(count512B == *needed512Blocks) // found space
-                    {
-                        found = 1;
-                        int8_t k, startIndex = j - *needed512Blocks + 1;
-                        for(k = j; k >= startIndex; k--)
-                        {
-                            (*inUse512)++;
-                            // mark occupied
-                            *currentBlock4kb |= (1 << k);
-                        }
-                        // depending on which block, return the index
-                        *allocatedIndex = (i == 0 || i == 1) ? ((i*16) + startIndex) : (24 + startIndex);
-                        return found;
-                    }
+                    found = true;
+                    bestWaste = waste;
+                    bestRun = runBytes;
+                    *startIndex = lo;
+                    *endIndex = hi + 1;
                 }
             }
         }
@@ -480,72 +407,118 @@ bool findConsecutiveSpace(uint8_t* allocatedIndex, uint8_t* needed1024Blocks, ui
     return found;
 }
 
+// srd bit of the subregion holding the address, SRD_INDEX_END for the heap end
 uint8_t calculateIndex(uint32_t* baseAddrValue, uint16_t* subregionSize)
 {
-    uint32_t region = *baseAddrValue & 0xFFFFF000;
-    uint16_t subregion = *baseAddrValue & 0x00000FFF;
-    uint8_t index = 0;
-
-    switch (region)
+    uint8_t i;
+    for (i = 0; i < NUM_HEAP_REGIONS; i++)
     {
-        case 0x20000000: // Region 0 : 4KB
-            *subregionSize = 512;
-            index = 0 + (subregion / *subregionSize);
-            break;
-        case 0x20001000: // Region 1 : 4KB
-            *subregionSize = 512;
-            index = 8 + (subregion / *subregionSize);
-            break;
-        case 0x20002000: // Region 2 : 8KB
-            *subregionSize = 1024;
-            index = 16 + (subregion / *subregionSize);
-            break;
-        case 0x20003000: // Region 2 : 8KB
-            *subregionSize = 1024;
-            index = 20 + (subregion / *subregionSize);
-            break;
-        case 0x20004000: // Region 3 : 4KB
-            *subregionSize = 512;
-            index = 24 + (subregion / *subregionSize);
-            break;
-        case 0x20005000: // Region 4 : 4KB
-            *subregionSize = 512;
-            index = 32 + (subregion / *subregionSize);
-            break;
-        case 0x20006000: // Region 5 : 8KB
-            *subregionSize = 1024;
-            index = 40 + (subregion / *subregionSize);
-            break;
-        case 0x20007000: // Region 5 : 8KB
-            *subregionSize = 1024;
-            index = 44 + (subregion / *subregionSize);
-            break;
-        case 0x20008000: // access to whole SRAM
-            index = 48;
-        default:
-            break;
+        const HEAP_REGION* region = &heapRegions[i];
+        if (*baseAddrValue >= region->base && *baseAddrValue < region->base + region->size)
+        {
+            *subregionSize = region->subregionSize;
+            return region->firstIndex + (*baseAddrValue - region->base) / region->subregionSize;
+        }
     }
-    return index;
+    if (*baseAddrValue == HEAP_END)
+        return SRD_INDEX_END;       // access to whole SRAM
+    return 0;
 }
 
-void addAllocation(uint32_t size, void* heapAddr, void* pid)
+// before the first mallocFromHeap, chains every record on the free list
+void initRegistry(void)
 {
     uint8_t i;
-    for(i = 0; i < 12; i++)
+    for (i = 0; i < MAX_MEMORY_ALLOCATION; i++)
+        allocatedData[i].next = (i + 1 < MAX_MEMORY_ALLOCATION) ? i + 1 : NO_ALLOCATION;
+    freeRecord = 0;
+    for (i = 0; i < MAX_TASKS; i++)
+        taskAllocations[i] = NO_ALLOCATION;
+    allocationCount = 0;
+}
+
+// new record is kernel owned, the sorted index is shifted up to make room
+bool addAllocation(uint32_t size, uint8_t start)
+{
+    uint8_t i, at;
+    if (freeRecord == NO_ALLOCATION)
+        return false;
+    i = freeRecord;
+    freeRecord = allocatedData[i].next;
+    allocatedData[i].owner = NO_OWNER;
+    allocatedData[i].next = NO_ALLOCATION;
+    allocatedData[i].size = size;
+    allocatedData[i].start = start;
+    for (at = allocationCount; at > 0 && allocatedData[byBase[at - 1]].start > start; at--)
+        byBase[at] = byBase[at - 1];
+    byBase[at] = i;
+    allocationCount++;
+    return true;
+}
+
+// place of base in byBase, NO_ALLOCATION if no allocation starts there,
+// srd bits run in address order, so the index sorts like the base
+uint8_t findAllocation(void* base)
+{
+    uint32_t address = (uint32_t)base;
+    uint16_t subregionSize;
+    uint8_t start, lo = 0, hi = allocationCount;
+    if (address < HEAP_ADDRESS || address >= HEAP_END)
+        return NO_ALLOCATION;
+    start = calculateIndex(&address, &subregionSize);
+    if (subregionAddress(start) != (uint32_t)base)
+        return NO_ALLOCATION;       // not on a subregion boundary
+    while (lo < hi)
     {
-        if(!allocatedData[i].inUse)
-        {
-            allocatedData[i].inUse = 1;
-            allocatedData[i].fnPid = pid;
-            allocatedData[i].size = size;
-            allocatedData[i].heapAddr = heapAddr;
-            usedSpace += size;
-            return;
-        }
+        uint8_t mid = (lo + hi) / 2;
+        uint8_t midStart = allocatedData[byBase[mid]].start;
+        if (midStart == start)
+            return mid;
+        if (midStart < start)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
+    return NO_ALLOCATION;
 }
 
 uint32_t getFreeSpace()
 {
-    return (TOTAL_SPACE - usedSpace);
+    return (HEAP_SIZE - usedSpace);
+}
+
+// one pass over the heap subregions, a run of one subregion size ends where the
+// size changes even if the next subregion is free too
+void getHeapStats(HEAP_STATS* stats)
+{
+    uint32_t run = 0, sameRun = 0;
+    uint8_t i, k;
+    stats->freeBytes = getFreeSpace();
+    stats->requestedBytes = requestedSpace;
+    stats->wastedBytes = usedSpace - requestedSpace;
+    stats->largestFree = 0;
+    for (i = 0; i < NUM_SUBREGION_SIZES; i++)
+        stats->largestFreeOf[i] = 0;
+    stats->allocations = allocationCount;
+    for (i = SRD_INDEX_HEAP; i < SRD_INDEX_END; i++)
+    {
+        uint16_t size = subregionSizeAt(i);
+        if (heapInUse & ((uint64_t)1 << i))
+        {
+            run = sameRun = 0;
+            continue;
+        }
+        run += size;
+        sameRun = (i > SRD_INDEX_HEAP && subregionSizeAt(i - 1) == size) ? sameRun + size : size;
+        if (run > stats->largestFree)
+            stats->largestFree = run;
+        for (k = 0; k < NUM_SUBREGION_SIZES; k++)
+            if (size == subregionSizes[k] && sameRun > stats->largestFreeOf[k])
+                stats->largestFreeOf[k] = sameRun;
+    }
+    stats->fragmentation = stats->freeBytes ? 100 - (stats->largestFree * 100) / stats->freeBytes : 0;
+    for (i = 0; i < ALLOC_FAIL_REASONS; i++)
+        stats->failures[i] = allocFailures[i];
+    for (i = 0; i < HEAP_HISTOGRAM_BUCKETS; i++)
+        stats->histogram[i] = requestHistogram[i];
 }
@@ -12,33 +12,88 @@
 #define MM_H_
 
 #include  <stdbool.h>
+#include "heapplan.h"
 
 #define NUM_SRAM_REGIONS 4
-#define MAX_MEMORY_ALLOCATION 15
+
+// MPU region 0, the whole flash, readable by every task
+#define FLASH_END 0x00040000
+
+// srd bits 0-7 are the kernel 4KB, never granted, heap region n owns bits
+// 8 * (n + 1) to 8 * (n + 1) + 7
+#define SRD_INDEX_HEAP 8
+#define SRD_INDEX_END (SRD_INDEX_HEAP + 8 * NUM_HEAP_REGIONS)
+
+// every allocation holds at least one heap subregion, so the registry can
+// never need more records than there are subregions, 40 with the 5 MPU
+// regions of 8 subregions the plan has to work with, more records could
+// never be used, a record is 8 B so the table stays small in the kernel 4KB
+#define MAX_MEMORY_ALLOCATION (SRD_INDEX_END - SRD_INDEX_HEAP)
+#define NO_ALLOCATION 0xFF          // end of a record list
+#define NO_OWNER 0xFF               // kernel owned, task stacks
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-// data of allocated task
+// data of allocated task, records of one owner are chained through next
 typedef struct _MALLOC_DATA
 {
-    bool inUse;
-    uint32_t size;
-    void* fnPid;
-    void* heapAddr;
+    uint32_t size;                  // requested bytes
+    uint8_t start;                  // srd bit of the first subregion, base is subregionAddress(start)
+    uint8_t owner;                  // tcb index or NO_OWNER
+    uint8_t next;                   // next record of the owner, or of the free list
+    uint8_t reserved;
 } MALLOC_DATA;
 
-MALLOC_DATA allocatedData[MAX_MEMORY_ALLOCATION];
+// why mallocFromHeap returned 0
+#define ALLOC_FAIL_SIZE 0           // 0 bytes or more than the whole heap
+#define ALLOC_FAIL_NO_SPACE 1       // fewer free bytes than asked for
+#define ALLOC_FAIL_FRAGMENTED 2     // enough free bytes, but no run holds them
+#define ALLOC_FAIL_REGISTRY 3       // no registry record left
+#define ALLOC_FAIL_REASONS 4
+
+// request sizes, bucket n counts sizes up to 64 << n, the last one the rest
+#define HEAP_HISTOGRAM_BUCKETS 9
+
+typedef struct _HEAP_STATS
+{
+    uint32_t freeBytes;
+    uint32_t requestedBytes;        // sum of live request sizes
+    uint32_t wastedBytes;           // lost to rounding up to whole subregions
+    uint32_t largestFree;           // largest run, what a single request can get
+    uint32_t largestFreeOf[NUM_SUBREGION_SIZES];   // largest run of one subregion size only
+    uint8_t  fragmentation;         // % of free bytes outside the largest run
+    uint8_t  allocations;           // live registry records
+    uint32_t failures[ALLOC_FAIL_REASONS];
+    uint32_t histogram[HEAP_HISTOGRAM_BUCKETS];
+} HEAP_STATS;
+
+extern const uint32_t subregionSizes[NUM_SUBREGION_SIZES];
+extern MALLOC_DATA allocatedData[MAX_MEMORY_ALLOCATION];
+extern uint8_t taskAllocations[];   // first record of each task, NO_ALLOCATION if none
+extern uint32_t heapReleases;
 
+void initRegistry(void);
 void * mallocFromHeap(uint32_t size_in_bytes);
 void freeToHeap(void *pMemory);
+bool resizeInHeap(void* base, uint32_t size_in_bytes);
+bool setAllocationOwner(void* base, uint8_t task);
+uint8_t allocationOwner(void* base);
+uint32_t allocationSize(void* base);
+uint32_t subregionAddress(uint8_t index);
+void freeTaskAllocations(uint8_t task);
 
 void allowFlashAccess(void);
 void allowPeripheralAccess(void);
+void allowKernelDataAccess(void);
 void setupSramAccess(void);
 uint64_t createNoSramAccessMask(void);
 void addSramAccessWindow(uint64_t *srdBitMask, uint32_t *baseAdd, uint32_t size_in_bytes);
+bool sramWindowOpen(uint64_t srdBitMask, uint32_t address, uint32_t size_in_bytes);
 void applySramAccessMask(uint64_t srdBitMask);
+uint16_t subregionSizeOf(uint32_t address);
 uint32_t getFreeSpace();
+void getHeapStats(HEAP_STATS* stats);
 
 #endif
@@ -0,0 +1,145 @@
+// Memory pool functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pool.h"
+#include "kernel.h"
+#include "asm_src.h"
+
+POOL pools[MAX_POOLS];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// room for the free list link and keeps every block word aligned
+uint16_t poolBlockSize(uint16_t blockSize)
+{
+    if (blockSize < sizeof(void*))
+        blockSize = sizeof(void*);
+    return (blockSize + 3) & ~3;
+}
+
+// links every block in address order, returns the pool number or -1
+int8_t poolSetup(const char name[], void* owner, void* base, uint16_t blockSize, uint16_t blocks)
+{
+    int8_t pool;
+    uint16_t i;
+    for (pool = 0; pool < MAX_POOLS && pools[pool].inUse; pool++);
+    if (pool == MAX_POOLS || !base || blocks == 0)
+        return -1;
+    for (i = 0; i < POOL_NAME_SIZE - 1 && name[i]; i++)
+        pools[pool].name[i] = name[i];
+    pools[pool].name[i] = '\0';
+    pools[pool].owner = owner;
+    pools[pool].base = (uint8_t*)base;
+    pools[pool].blockSize = blockSize;
+    pools[pool].blocks = blocks;
+    pools[pool].used = 0;
+    pools[pool].peak = 0;
+    pools[pool].failed = 0;
+    for (i = 0; i < blocks - 1; i++)
+        *(void**)(pools[pool].base + i * blockSize) = pools[pool].base + (i + 1) * blockSize;
+    *(void**)(pools[pool].base + i * blockSize) = 0;
+    pools[pool].freeList = base;
+    pools[pool].inUse = true;
+    return pool;
+}
+
+void* poolTake(int8_t pool)
+{
+    void* block;
+    if (pool < 0 || pool >= MAX_POOLS || !pools[pool].inUse)
+        return 0;
+    block = pools[pool].freeList;
+    if (!block)
+    {
+        pools[pool].failed++;
+        return 0;
+    }
+    pools[pool].freeList = *(void**)block;
+    if (++pools[pool].used > pools[pool].peak)
+        pools[pool].peak = pools[pool].used;
+    return block;
+}
+
+// a block from another pool or a misaligned pointer is refused, so a bad
+// free cannot splice foreign memory into the list
+bool poolGive(int8_t pool, void* block)
+{
+    uint32_t offset;
+    if (pool < 0 || pool >= MAX_POOLS || !pools[pool].inUse || pools[pool].used == 0)
+        return false;
+    offset = (uint8_t*)block - pools[pool].base;
+    if ((uint8_t*)block < pools[pool].base || offset >= (uint32_t)pools[pool].blocks * pools[pool].blockSize
+            || offset % pools[pool].blockSize != 0)
+        return false;
+    *(void**)block = pools[pool].freeList;
+    pools[pool].freeList = block;
+    pools[pool].used--;
+    return true;
+}
+
+// the blocks are a child allocation of the owner and go back to the heap
+// with its other allocations when it is killed
+void poolRelease(void* owner)
+{
+    uint8_t i;
+    for (i = 0; i < MAX_POOLS; i++)
+        if (pools[i].inUse && pools[i].owner == owner)
+            pools[i].inUse = false;
+}
+
+// true if base is the heap allocation under a live pool
+bool poolOwnsAllocation(void* base)
+{
+    uint8_t i;
+    for (i = 0; i < MAX_POOLS; i++)
+        if (pools[i].inUse && pools[i].base == (uint8_t*)base)
+            return true;
+    return false;
+}
+
+int8_t poolCreate(const char name[], uint16_t blockSize, uint16_t blocks)
+{
+    __asm(" SVC #35");
+    return (int8_t)reg0();
+}
+
+void* poolAlloc(int8_t pool)
+{
+    __asm(" SVC #36");
+    return (void*)reg0();
+}
+
+void poolFree(int8_t pool, void* block)
+{
+    __asm(" SVC #37");
+}
+
+void* poolAllocFromIsr(int8_t pool)
+{
+    uint32_t basepri = enterCritical();
+    void* block = poolTake(pool);
+    leaveCritical(basepri);
+    return block;
+}
+
+void poolFreeFromIsr(int8_t pool, void* block)
+{
+    uint32_t basepri = enterCritical();
+    poolGive(pool, block);
+    leaveCritical(basepri);
+}
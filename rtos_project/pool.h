@@ -0,0 +1,70 @@
+// Memory pool functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//-----------------------------------------------------------------------------
+// Memory pools
+//-----------------------------------------------------------------------------
+
+#define MAX_POOLS 4
+#define POOL_NAME_SIZE 12
+#define POOL_MAX_BLOCK_SIZE 0xFFFC     // still fits blockSize once rounded up to a word
+#define POOL_MAX_BLOCKS 0xFFFF
+
+// N equal blocks carved from one heap allocation owned by the creating task,
+// a free block holds the address of the next free block, so take and give
+// are a single pointer swap
+// the control block lives in kernel memory, only the owner reaches it through
+// the svc as the blocks are in its window, isrs are privileged and use the
+// FromIsr variants, so an isr can fill blocks the owner task consumes
+typedef struct _POOL
+{
+    bool     inUse;
+    char     name[POOL_NAME_SIZE];
+    void*    owner;                // pid of the task whose heap holds the blocks
+    uint8_t* base;
+    void*    freeList;             // first free block, 0 when exhausted
+    uint16_t blockSize;            // bytes, a multiple of 4
+    uint16_t blocks;
+    uint16_t used;                 // blocks handed out
+    uint16_t peak;                 // high-water mark of used
+    uint16_t failed;               // requests made while exhausted
+} POOL;
+
+extern POOL pools[MAX_POOLS];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// kernel side, called from the svc with kernel isrs already masked
+uint16_t poolBlockSize(uint16_t blockSize);
+int8_t poolSetup(const char name[], void* owner, void* base, uint16_t blockSize, uint16_t blocks);
+void* poolTake(int8_t pool);
+bool poolGive(int8_t pool, void* block);
+void poolRelease(void* owner);
+bool poolOwnsAllocation(void* base);
+
+// user side, returns the pool number or -1 if no slot or heap is left, or the
+// sizes are out of range, alloc and free only work for the creating task
+int8_t poolCreate(const char name[], uint16_t blockSize, uint16_t blocks);
+void* poolAlloc(int8_t pool);
+void poolFree(int8_t pool, void* block);
+
+// handler mode, only from interrupts at KERNEL_INT_PRIORITY or lower
+void* poolAllocFromIsr(int8_t pool);
+void poolFreeFromIsr(int8_t pool, void* block);
+
+#endif
@@ -0,0 +1,181 @@
+// Sampling profiler functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Hardware configuration:
+// Timer 4A - sample clock, zero latency class so it also lands in critical sections
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "prof.h"
+#include "kernel.h"
+#include "kdata.h"
+#include "mm.h"
+#include "nvic.h"
+#include "vtable.h"
+#include "asm_src.h"
+#include "uart0.h"
+#include "c_fnc.h"
+
+PROF_BIN* profBins = 0;
+uint32_t profSamples;              // all samples since start
+uint32_t profKernelSamples;        // another handler was interrupted, no task pc
+uint32_t profDropped;              // no free bin within PROF_PROBES
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initProfiler(void)
+{
+    // Enable clocks
+    SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R4;
+    _delay_cycles(3);
+    // Configure Timer 4 as the sample clock, interrupt stays off until prof start
+    TIMER4_CTL_R  &= ~TIMER_CTL_TAEN;                // turn-off timer before reconfiguring
+    TIMER4_CFG_R   = TIMER_CFG_32_BIT_TIMER;         // configure as 32-bit timer (A+B)
+    TIMER4_TAMR_R  = TIMER_TAMR_TAMR_PERIOD;         // configure for periodic mode (count down)
+    TIMER4_TAILR_R = PROF_PERIOD;                    // set load value (~1 kHz rate)
+    TIMER4_IMR_R   = 0;
+    attachIsr(INT_TIMER4A, profilerIsr, false);
+    setNvicInterruptPriority(INT_TIMER4A, ZERO_LATENCY_INT_PRIORITY);
+    enableNvicInterrupt(INT_TIMER4A);
+}
+
+// only a thread was interrupted if this is the only active handler, then its
+// hw frame is on the psp with the pc 6 words in
+void profilerIsr(void)
+{
+    uint32_t pc, index;
+    uint8_t task, i;
+    TIMER4_ICR_R = TIMER_ICR_TATOCINT;
+    profSamples++;
+    if (!(NVIC_INT_CTRL_R & NVIC_INT_CTRL_RET_BASE))
+    {
+        profKernelSamples++;
+        return;
+    }
+    pc = ((uint32_t*)getPsp())[6];
+    task = kdata.taskCurrent;
+    index = ((pc >> 1) ^ ((uint32_t)task << 7)) * 2654435761U >> 24;   // 8 bit hash for 256 bins
+    for (i = 0; i < PROF_PROBES; i++)
+    {
+        PROF_BIN* bin = &profBins[(index + i) & (PROF_BINS - 1)];
+        if (bin->pc == pc && bin->task == task)
+        {
+            if (bin->count != 0xFFFF)
+                bin->count++;
+            return;
+        }
+        if (bin->pc == 0)
+        {
+            bin->task = task;
+            bin->count = 1;
+            bin->pc = pc;
+            return;
+        }
+    }
+    profDropped++;
+}
+
+// bins taken from the heap on first start and kept, each start clears them
+bool profStart(void)
+{
+    uint16_t i;
+    profStop();
+    if (profBins == 0)
+        profBins = mallocFromHeap(PROF_BINS * sizeof(PROF_BIN));
+    if (profBins == 0)
+        return false;
+    for (i = 0; i < PROF_BINS; i++)
+        profBins[i].pc = 0;
+    profSamples = profKernelSamples = profDropped = 0;
+    TIMER4_ICR_R = TIMER_ICR_TATOCINT;
+    TIMER4_IMR_R = TIMER_IMR_TATOIM;
+    TIMER4_CTL_R |= TIMER_CTL_TAEN;
+    return true;
+}
+
+void profStop(void)
+{
+    TIMER4_CTL_R &= ~TIMER_CTL_TAEN;
+    TIMER4_IMR_R = 0;
+}
+
+static void printProfLine(PROF_BIN* bin)
+{
+    char str[12];
+    putsUart0("P ");
+    putsUart0(taskNameOf(bin->task)); putcUart0(' ');
+    putsUart0(uint32ToHexString(&bin->pc, str)); putcUart0(' ');
+    putsUart0(numToStr(bin->count, str)); putcUart0('\n');
+}
+
+// top PROF_TOP bins, or every bin for tools/symbolize.py
+// sampling is paused so the isr does not change a bin while it is read
+void profReport(bool all)
+{
+    char str[12];
+    bool running = (TIMER4_IMR_R & TIMER_IMR_TATOIM) != 0;
+    uint16_t i, j, best;
+    uint16_t last = 0xFFFF;
+    uint32_t lastPc = 0;
+    uint8_t lastTask = 0;
+    if (profBins == 0)
+    {
+        putsUart0("prof: not started\n");
+        return;
+    }
+    TIMER4_IMR_R = 0;
+    putsUart0("#prof ");
+    putsUart0(numToStr(profSamples, str)); putsUart0(" samples, ");
+    putsUart0(numToStr(profKernelSamples, str)); putsUart0(" in handlers, ");
+    putsUart0(numToStr(profDropped, str)); putsUart0(" dropped\n");
+    if (all)
+    {
+        for (i = 0; i < PROF_BINS; i++)
+            if (profBins[i].pc != 0)
+                printProfLine(&profBins[i]);
+    }
+    else
+    {
+        // repeated max scan, ties broken by pc and task so every bin shows once
+        for (j = 0; j < PROF_TOP; j++)
+        {
+            best = PROF_BINS;
+            for (i = 0; i < PROF_BINS; i++)
+            {
+                PROF_BIN* bin = &profBins[i];
+                if (bin->pc == 0)
+                    continue;
+                if (last != 0xFFFF && (bin->count > last || (bin->count == last &&
+                    (bin->pc > lastPc || (bin->pc == lastPc && bin->task >= lastTask)))))
+                    continue;
+                if (best == PROF_BINS || bin->count > profBins[best].count ||
+                    (bin->count == profBins[best].count && (bin->pc > profBins[best].pc ||
+                    (bin->pc == profBins[best].pc && bin->task > profBins[best].task))))
+                    best = i;
+            }
+            if (best == PROF_BINS)
+                break;
+            printProfLine(&profBins[best]);
+            last = profBins[best].count;
+            lastPc = profBins[best].pc;
+            lastTask = profBins[best].task;
+        }
+    }
+    putsUart0("#prof end\n");
+    if (running)
+        TIMER4_IMR_R = TIMER_IMR_TATOIM;
+}
@@ -0,0 +1,57 @@
+// Sampling profiler functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Hardware configuration:
+// Timer 4A - sample clock, zero latency class so it also lands in critical sections
+
+#ifndef PROF_H_
+#define PROF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//-----------------------------------------------------------------------------
+// Profiler
+//-----------------------------------------------------------------------------
+
+#define PROF_BINS 256                  // power of two, 8 B each, taken from the heap
+#define PROF_PROBES 8                  // bins tried before a sample is dropped
+#define PROF_TOP 10                    // lines in the prof report
+#define PROF_PERIOD 39971              // ~1 kHz, off the systick period to avoid aliasing
+
+// shell commands, passed in r0 of the prof svc
+#define PROF_STOP   0
+#define PROF_START  1
+#define PROF_REPORT 2
+#define PROF_DUMP   3
+
+// one bin per task and pc
+typedef struct _PROF_BIN
+{
+    uint32_t pc;                   // 0 if the bin is free
+    uint8_t  task;
+    uint8_t  reserved;
+    uint16_t count;                // saturates
+} PROF_BIN;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// privileged, call from main after initVectorTable
+void initProfiler(void);
+void profilerIsr(void);
+
+// kernel side, called from the svc
+bool profStart(void);
+void profStop(void);
+void profReport(bool all);
+
+#endif
@@ -0,0 +1,178 @@
+// Ring buffer functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ringbuf.h"
+#include "kernel.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// records must be a power of two so the index wraps with a mask
+bool ringInit(RING* ring, void* buffer, uint32_t records, uint16_t recordSize)
+{
+    bool ok = (records != 0) && ((records & (records - 1)) == 0) && (recordSize != 0) && buffer;
+    if (ok)
+    {
+        ring->head = 0;
+        ring->tail = 0;
+        ring->mask = records - 1;
+        ring->recordSize = recordSize;
+        ring->buffer = (uint8_t*)buffer;
+        ring->wakeFn = 0;
+        ring->wakeArg = 0;
+    }
+    return ok;
+}
+
+// post() works for a producer task, an ISR producer needs an ISR-safe post
+void ringSetWakeHook(RING* ring, _ringHook fn, int8_t arg)
+{
+    ring->wakeArg = arg;
+    ring->wakeFn = fn;
+}
+
+uint32_t ringCount(RING* ring)
+{
+    return ring->head - ring->tail;
+}
+
+uint32_t ringSpace(RING* ring)
+{
+    return (ring->mask + 1) - (ring->head - ring->tail);
+}
+
+bool ringIsEmpty(RING* ring)
+{
+    return (ring->head == ring->tail);
+}
+
+// data stored before head moves, so consumer never sees a half written record
+// tail is read after head moves, not before, as a task producer can be
+// preempted while the consumer drains the ring and blocks, a tail at the old
+// head means the ring was empty and the consumer is woken, any other tail
+// means it still has records and sees the new head before it checks again
+static void ringPublish(RING* ring, uint32_t head)
+{
+    uint32_t last = ring->head;
+    __asm(" DMB");
+    ring->head = head;
+    __asm(" DMB");
+    if (ring->tail == last && ring->wakeFn)
+        ring->wakeFn(ring->wakeArg);
+}
+
+// record read before tail moves, so producer never overwrites it early
+static void ringRelease(RING* ring, uint32_t tail)
+{
+    __asm(" DMB");
+    ring->tail = tail;
+}
+
+bool ringPutByte(RING* ring, uint8_t data)
+{
+    uint32_t head = ring->head;
+    if ((head - ring->tail) > ring->mask)       // full
+        return false;
+    ring->buffer[head & ring->mask] = data;
+    ringPublish(ring, head + 1);
+    return true;
+}
+
+// writes as much as fits, returns bytes written
+uint32_t ringWrite(RING* ring, const uint8_t data[], uint32_t length)
+{
+    uint32_t head = ring->head;
+    uint32_t space = (ring->mask + 1) - (head - ring->tail);
+    uint32_t i;
+    if (length > space)
+        length = space;
+    for (i = 0; i < length; i++)
+        ring->buffer[(head + i) & ring->mask] = data[i];
+    if (length)
+        ringPublish(ring, head + length);
+    return length;
+}
+
+bool ringPutRecord(RING* ring, const void* record)
+{
+    uint32_t head = ring->head;
+    uint8_t* dst;
+    uint16_t i;
+    if ((head - ring->tail) > ring->mask)       // full
+        return false;
+    dst = &ring->buffer[(head & ring->mask) * ring->recordSize];
+    for (i = 0; i < ring->recordSize; i++)
+        dst[i] = ((const uint8_t*)record)[i];
+    ringPublish(ring, head + 1);
+    return true;
+}
+
+bool ringGetByte(RING* ring, uint8_t* data)
+{
+    uint32_t tail = ring->tail;
+    if (ring->head == tail)                     // empty
+        return false;
+    __asm(" DMB");
+    *data = ring->buffer[tail & ring->mask];
+    ringRelease(ring, tail + 1);
+    return true;
+}
+
+// reads up to length bytes, returns bytes read
+uint32_t ringRead(RING* ring, uint8_t data[], uint32_t length)
+{
+    uint32_t tail = ring->tail;
+    uint32_t count = ring->head - tail;
+    uint32_t i;
+    if (length > count)
+        length = count;
+    if (length == 0)
+        return 0;
+    __asm(" DMB");
+    for (i = 0; i < length; i++)
+        data[i] = ring->buffer[(tail + i) & ring->mask];
+    ringRelease(ring, tail + length);
+    return length;
+}
+
+bool ringGetRecord(RING* ring, void* record)
+{
+    uint32_t tail = ring->tail;
+    uint8_t* src;
+    uint16_t i;
+    if (ring->head == tail)                     // empty
+        return false;
+    __asm(" DMB");
+    src = &ring->buffer[(tail & ring->mask) * ring->recordSize];
+    for (i = 0; i < ring->recordSize; i++)
+        ((uint8_t*)record)[i] = src[i];
+    ringRelease(ring, tail + 1);
+    return true;
+}
+
+// consumer task blocks on the wake semaphore until the producer publishes,
+// spurious posts just loop once more
+void ringWaitData(RING* ring)
+{
+    while (ringIsEmpty(ring))
+    {
+        if (ring->wakeFn)
+            wait(ring->wakeArg);
+        else
+            yield();
+    }
+}
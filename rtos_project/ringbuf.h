@@ -0,0 +1,63 @@
+// Ring buffer functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef RINGBUF_H_
+#define RINGBUF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//-----------------------------------------------------------------------------
+// Ring buffer
+//-----------------------------------------------------------------------------
+
+// wake hook called by the producer when the consumer had emptied the ring by
+// the time the new head was stored, arg is a semaphore index so post() fits
+// directly
+typedef void (*_ringHook)(int8_t arg);
+
+// Lock-free single-producer/single-consumer ring
+// head only written by the producer, tail only by the consumer, both run freely
+// and wrap through mask, so count = head - tail even after 32 bit overflow
+// buffer and ring struct must be reachable by both sides (task heap memory,
+// ISRs are privileged and can reach it anyway)
+typedef struct _RING
+{
+    volatile uint32_t head;        // next record to write
+    volatile uint32_t tail;        // next record to read
+    uint32_t  mask;                // records - 1, records is a power of two
+    uint16_t  recordSize;          // bytes per record, 1 for a byte stream
+    uint8_t*  buffer;              // records * recordSize bytes
+    _ringHook wakeFn;              // optional, 0 if consumer polls
+    int8_t    wakeArg;
+} RING;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+bool ringInit(RING* ring, void* buffer, uint32_t records, uint16_t recordSize);
+void ringSetWakeHook(RING* ring, _ringHook fn, int8_t arg);
+uint32_t ringCount(RING* ring);
+uint32_t ringSpace(RING* ring);
+bool ringIsEmpty(RING* ring);
+
+// producer side
+bool ringPutByte(RING* ring, uint8_t data);
+uint32_t ringWrite(RING* ring, const uint8_t data[], uint32_t length);
+bool ringPutRecord(RING* ring, const void* record);
+
+// consumer side
+bool ringGetByte(RING* ring, uint8_t* data);
+uint32_t ringRead(RING* ring, uint8_t data[], uint32_t length);
+bool ringGetRecord(RING* ring, void* record);
+void ringWaitData(RING* ring);
+
+#endif
@@ -17,6 +17,8 @@
 
 // Hardware configuration:
 // 6 Pushbuttons and 5 LEDs, UART
+// Timer 1A and 2A interrupt latency test (kernel aware and zero latency class), off until latency start
+// Timer 4A sampling profiler
 // UART Interface:
 //   U0TX (PA1) and U0RX (PA0) are connected to the 2nd controller
 //   The USB on the 2nd controller enumerates to an ICDI interface and a virtual COM port
@@ -41,6 +43,10 @@
 #include "faults.h"
 #include "tasks.h"
 #include "shell.h"
+#include "latency.h"
+#include "vtable.h"
+#include "workq.h"
+#include "prof.h"
 
 //-----------------------------------------------------------------------------
 // Main
@@ -56,14 +62,21 @@ int main(void)
     initUart0();
     allowFlashAccess();
     allowPeripheralAccess();
+    allowKernelDataAccess();
     setupSramAccess();
+    initVectorTable();
     initRtos();
+    initLatencyTest();
 
     // Initialize mutexes and semaphores
     initMutex(resource);
     initSemaphore(keyPressed, 1);
     initSemaphore(keyReleased, 0);
     initSemaphore(flashReq, 5);
+    initSemaphore(keyDown, 0);
+    initSemaphore(workReady, 0);
+    initWorkQueue();
+    initPbInterrupts();
 
     // Add required idle process at lowest priority
     ok =  createThread(idle, "Idle", 15, 512);
@@ -76,20 +89,11 @@ int main(void)
     ok &= createThread(important, "Important", 0, 1024);
     ok &= createThread(uncooperative, "Uncoop", 12, 1024);
     ok &= createThread(errant, "Errant", 12, 512);
-    ok &= createThread(shell, "Shell", 12, 4096);
+    ok &= createThread(shell, "Shell", 12, 4096 | STACK_GUARD);
+    ok &= createThread(worker, "Worker", WORKER_PRIORITY, 512 | STACK_GUARD);
 
-    // TODO: Add code to implement a periodic timer and ISR
-    // Enable clocks
-    SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R4;
-    _delay_cycles(3);
-    // Configure Timer 4 for 1 sec tick
-    TIMER4_CTL_R  &= ~TIMER_CTL_TAEN;                // turn-off timer before reconfiguring
-    TIMER4_CFG_R   = TIMER_CFG_32_BIT_TIMER;         // configure as 32-bit timer (A+B)
-    TIMER4_TAMR_R  = TIMER_TAMR_TAMR_PERIOD;         // configure for periodic mode (count down)
-    TIMER4_TAILR_R = 40000000;                       // set load value (1 Hz rate)
-    //TIMER4_CTL_R  |= TIMER_CTL_TAEN;                 // turn-on timer
-    //TIMER4_IMR_R  |= TIMER_IMR_TATOIM;               // turn-on interrupt
-    //NVIC_EN2_R    |= 1 << (INT_TIMER4A-80);          // turn-on interrupt 86 (TIMER4A)
+    // Timer 4 drives the sampling profiler, off until 'prof start'
+    initProfiler();
 
     // Start up RTOS
     if (ok)
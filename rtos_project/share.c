@@ -0,0 +1,107 @@
+// Shared region functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "share.h"
+#include "asm_src.h"
+
+SHARE shares[MAX_SHARES];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+static bool nameIs(const char a[], const char b[])
+{
+    uint8_t i;
+    for (i = 0; i < SHARE_NAME_SIZE - 1 && a[i] == b[i] && a[i]; i++);
+    return (i == SHARE_NAME_SIZE - 1) || (a[i] == b[i]);
+}
+
+// name must be unused, returns the share number or -1
+int8_t shareSetup(const char name[], uint8_t owner, uint32_t base, uint32_t size)
+{
+    int8_t share;
+    uint8_t i;
+    if (!name[0] || shareOfName(name) >= 0)
+        return -1;
+    for (share = 0; share < MAX_SHARES && shares[share].inUse; share++);
+    if (share == MAX_SHARES)
+        return -1;
+    for (i = 0; i < SHARE_NAME_SIZE - 1 && name[i]; i++)
+        shares[share].name[i] = name[i];
+    shares[share].name[i] = '\0';
+    shares[share].owner = owner;
+    shares[share].base = base;
+    shares[share].size = size;
+    shares[share].readers = 0;
+    shares[share].writers = 0;
+    shares[share].inUse = true;
+    return share;
+}
+
+int8_t shareOfBase(uint32_t base)
+{
+    int8_t i;
+    for (i = 0; i < MAX_SHARES; i++)
+        if (shares[i].inUse && shares[i].base == base)
+            return i;
+    return -1;
+}
+
+int8_t shareOfName(const char name[])
+{
+    int8_t i;
+    for (i = 0; i < MAX_SHARES; i++)
+        if (shares[i].inUse && nameIs(shares[i].name, name))
+            return i;
+    return -1;
+}
+
+uint16_t shareGrantees(int8_t share)
+{
+    return shares[share].readers | shares[share].writers;
+}
+
+// allocates in the caller's window and names it, 0 if the name is taken or
+// there is no room
+void* shareCreate(const char name[], uint32_t size)
+{
+    __asm(" SVC #40");
+    return (void*)reg0();
+}
+
+// owner only, access is SHARE_WRITE or SHARE_NONE to revoke, SHARE_READ is
+// refused as the MPU can not keep a read grant from writing
+bool shareGrant(void* base, _fn fn, uint8_t access)
+{
+    __asm(" SVC #41");
+    return (bool)reg0();
+}
+
+// base of a share granted to the caller, 0 if there is none by that name
+void* shareOpen(const char name[])
+{
+    __asm(" SVC #42");
+    return (void*)reg0();
+}
+
+// owner only, revokes every grant and frees the share, false if the caller
+// does not own one at base
+bool shareDestroy(void* base)
+{
+    __asm(" SVC #46");
+    return (bool)reg0();
+}
@@ -0,0 +1,66 @@
+// Shared region functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef SHARE_H_
+#define SHARE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "kernel.h"
+
+//-----------------------------------------------------------------------------
+// Shared regions
+//-----------------------------------------------------------------------------
+
+#define MAX_SHARES 4
+#define SHARE_NAME_SIZE 12
+
+// access a grant gives, SHARE_NONE revokes
+// the MPU access permissions belong to a whole region, not to one task's
+// subregions, so a read grant would open the same window as a write grant,
+// the svc refuses SHARE_READ until an MPU plan can enforce it
+#define SHARE_NONE  0
+#define SHARE_READ  1
+#define SHARE_WRITE 2
+
+// a heap allocation of the owner, merged into the srd mask of each task it is
+// granted to, the owner can not free or resize it while it is shared, only
+// destroy it, it goes with the owner's other allocations when the owner is
+// killed
+typedef struct _SHARE
+{
+    bool     inUse;
+    char     name[SHARE_NAME_SIZE];
+    uint8_t  owner;                // tcb index
+    uint32_t base;
+    uint32_t size;
+    uint16_t readers;              // bit n set for tcb index n
+    uint16_t writers;
+} SHARE;
+
+extern SHARE shares[MAX_SHARES];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// kernel side, called from the svc
+int8_t shareSetup(const char name[], uint8_t owner, uint32_t base, uint32_t size);
+int8_t shareOfBase(uint32_t base);
+int8_t shareOfName(const char name[]);
+uint16_t shareGrantees(int8_t share);
+
+// user side
+void* shareCreate(const char name[], uint32_t size);
+bool shareGrant(void* base, _fn fn, uint8_t access);
+void* shareOpen(const char name[]);
+bool shareDestroy(void* base);
+
+#endif
@@ -20,6 +20,11 @@
 #include "uart0.h"
 #include "kernel.h"
 #include "asm_src.h"
+#include "kdata.h"
+#include "trace.h"
+#include "prof.h"
+#include "latency.h"
+#include "crash.h"
 
 // REQUIRED: Add header files here for your strings functions, ...
 // data from UI
@@ -38,11 +43,48 @@ typedef struct _USER_DATA
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
+// load in LOAD_FIXED_1 units printed as a percent with two decimals
+void printLoad(uint16_t load)
+{
+    char str[12];
+    uint32_t hundredths = ((uint32_t)load * 10000) >> LOAD_FSHIFT;
+    putsUart0(numToStr(hundredths / 100, str));
+    putcUart0('.');
+    if (hundredths % 100 < 10) putcUart0('0');
+    putsUart0(numToStr(hundredths % 100, str));
+}
+
+// reads the kernel data page directly, no service call
+void uptime(void)
+{
+    uint64_t ms = getTickCount();
+    uint16_t load[LOAD_WINDOWS];
+    char str[12];
+    putsUart0("up ");
+    putsUart0(numToStr((uint32_t)(ms / 1000), str));
+    putcUart0('.');
+    ms %= 1000;
+    if (ms < 100) putcUart0('0');
+    if (ms < 10) putcUart0('0');
+    putsUart0(numToStr((uint32_t)ms, str));
+    putsUart0(" s, task ");
+    putsUart0(numToStr(getTaskCurrent(), str));
+    putsUart0(", load average % ");
+    getSystemLoad(load);
+    printLoad(load[0]); putsUart0(", ");
+    printLoad(load[1]); putsUart0(", ");
+    printLoad(load[2]);
+    putcUart0('\n');
+}
+
 void pkill(char str[]);
 void pidof(char name[]);
 void sched(bool prio_on);
 void preempt(bool on);
 void pi(bool on);
+void autorestart(bool on);
+void oom(uint8_t policy);
+void crash(uint8_t command);
 void kill(uint32_t pid);
 void ipcs(void);
 void ps(PS_DATA* psInfo);
@@ -51,6 +93,11 @@ int32_t getFieldInteger(USER_DATA* data, uint8_t fieldNumber);
 char* getFieldString(USER_DATA* data, uint8_t fieldNumber);
 void parseFields(USER_DATA* data);
 void resetTask(char taskName[]);
+void latency(uint8_t command);
+void irqstat(bool reset);
+uint32_t traceRequest(uint8_t command, void* buffer, uint32_t count);
+void trace(uint8_t command);
+void prof(uint8_t command);
 
 // REQUIRED: add processing for the shell commands through the UART here
 void shell(void)
@@ -61,6 +108,7 @@ void shell(void)
     USER_DATA data;
     PS_DATA psInfo[MAX_PS_DATA];
 
+    setMemoryPressure(0, true);         // the shell is how a stuck system gets recovered
     putsUart0("\nuser@rtos:~$ ");
     while(true)
     {
@@ -115,6 +163,26 @@ void shell(void)
                     bool on = strCmp(getFieldString(&data, 1), "on");
                     preempt(on);
                 }
+                else if(isCommand(&data, "autorestart", 1))
+                {
+                    bool on = strCmp(getFieldString(&data, 1), "on");
+                    autorestart(on);
+                }
+                else if(isCommand(&data, "oom", 1))
+                {
+                    char* policy = getFieldString(&data, 1);
+                    if (strCmp(policy, "lowest"))
+                        oom(OOM_KILL_LOWEST);
+                    else if (strCmp(policy, "largest"))
+                        oom(OOM_KILL_LARGEST);
+                    else
+                        oom(OOM_NONE);
+                }
+                else if(isCommand(&data, "crash", 0))
+                {
+                    bool clear = (data.fieldCount > 1) && strCmp(getFieldString(&data, 1), "clear");
+                    crash(clear ? CRASH_CLEAR : CRASH_SHOW);
+                }
                 else if(isCommand(&data, "sched", 1))
                 {
                     bool prio_on = strCmp(getFieldString(&data, 1), "prio");
@@ -124,6 +192,49 @@ void shell(void)
                 {
                     pidof(getFieldString(&data, 1));
                 }
+                else if(isCommand(&data, "uptime", 0))
+                {
+                    uptime();
+                }
+                else if(isCommand(&data, "latency", 0))
+                {
+                    char* arg = (data.fieldCount > 1) ? getFieldString(&data, 1) : "";
+                    if (strCmp(arg, "start"))
+                        latency(LATENCY_START);
+                    else if (strCmp(arg, "stop"))
+                        latency(LATENCY_STOP);
+                    else if (strCmp(arg, "reset"))
+                        latency(LATENCY_RESET);
+                    else
+                        latency(LATENCY_SHOW);
+                }
+                else if(isCommand(&data, "irqstat", 0))
+                {
+                    bool reset = (data.fieldCount > 1) && strCmp(getFieldString(&data, 1), "reset");
+                    irqstat(reset);
+                }
+                else if(isCommand(&data, "trace", 1))
+                {
+                    char* arg = getFieldString(&data, 1);
+                    if (strCmp(arg, "start"))
+                        trace(TRACE_START);
+                    else if (strCmp(arg, "dump"))
+                        trace(TRACE_DUMP);
+                    else
+                        trace(TRACE_STOP);
+                }
+                else if(isCommand(&data, "prof", 0))
+                {
+                    char* arg = (data.fieldCount > 1) ? getFieldString(&data, 1) : "";
+                    if (strCmp(arg, "start"))
+                        prof(PROF_START);
+                    else if (strCmp(arg, "stop"))
+                        prof(PROF_STOP);
+                    else if (strCmp(arg, "dump"))
+                        prof(PROF_DUMP);
+                    else
+                        prof(PROF_REPORT);
+                }
                 else if(isCommand(&data, "meminfo", 0))
                 {
                     __asm(" SVC #15");
@@ -209,6 +320,41 @@ void pi(bool on)
     }
 }
 
+void autorestart(bool on)
+{
+    __asm(" SVC #32");
+    if(on)
+    {
+        putsUart0("autorestart on");
+        putcUart0('\n');
+    }
+    else
+    {
+        putsUart0("autorestart off");
+        putcUart0('\n');
+    }
+}
+
+// the policy runs for a mallocWait still short of free subregions a tick
+// after the reclaimers were notified
+void oom(uint8_t policy)
+{
+    setOomPolicy(policy);
+    putsUart0("oom ");
+    if (policy == OOM_KILL_LOWEST)
+        putsUart0("lowest");
+    else if (policy == OOM_KILL_LARGEST)
+        putsUart0("largest");
+    else
+        putsUart0("none");
+    putcUart0('\n');
+}
+
+void crash(uint8_t command)
+{
+    __asm(" SVC #33");
+}
+
 void kill(uint32_t pid)
 {
     __asm(" SVC #9");
@@ -218,6 +364,77 @@ void kill(uint32_t pid)
     putsUart0(" killed\n");
 }
 
+void latency(uint8_t command)
+{
+    __asm(" SVC #27");
+    if (command == LATENCY_RESET)
+        putsUart0("latency cleared\n");
+}
+
+void irqstat(bool reset)
+{
+    __asm(" SVC #28");
+    if (reset)
+        putsUart0("irq stats cleared\n");
+}
+
+uint32_t traceRequest(uint8_t command, void* buffer, uint32_t count)
+{
+    __asm(" SVC #30");
+    return reg0();
+}
+
+// one line per event, "E cycles info" in hex, oldest first, after an "N" line
+// per task, tools/trace2json.py turns a captured dump into chrome trace json
+// the kernel only copies the events out, the printing is done here
+void trace(uint8_t command)
+{
+    TRACE_EVENT events[TRACE_CHUNK];
+    char name[NAME_SIZE];
+    char str[12];
+    uint32_t head, first, count, i;
+    uint8_t task;
+    if (command != TRACE_DUMP)
+    {
+        traceRequest(command, 0, 0);
+        return;
+    }
+    head = traceRequest(TRACE_DUMP, 0, 0);          // stops the trace
+    for (task = 0; traceRequest(TRACE_NAME, name, task); task++)
+    {
+        putsUart0("N "); putsUart0(numToStr(task, str)); putcUart0(' ');
+        putsUart0(name); putcUart0('\n');
+    }
+    if (head == 0)
+    {
+        putsUart0("#trace empty\n");
+        return;
+    }
+    first = (head > TRACE_EVENTS) ? head - TRACE_EVENTS : 0;
+    putsUart0("#trace begin ");
+    putsUart0(numToStr(head - first, str));
+    putsUart0(" events, ");
+    putsUart0(numToStr(first, str));
+    putsUart0(" lost\n");
+    while ((count = traceRequest(TRACE_READ, events, TRACE_CHUNK)) != 0)
+    {
+        for (i = 0; i < count; i++)
+        {
+            putsUart0("E ");
+            putsUart0(uint32ToHexString(&events[i].cycles, str));
+            putcUart0(' ');
+            putsUart0(uint32ToHexString(&events[i].info, str));
+            putcUart0('\n');
+        }
+    }
+    putsUart0("#trace end\n");
+}
+
+void prof(uint8_t command)
+{
+    __asm(" SVC #31");
+}
+
 void ipcs(void)
 {
     __asm(" SVC #8");
@@ -225,25 +442,45 @@ void ipcs(void)
     putcUart0('\n');
 }
 
+// state, stack peak and the lazily folded task loads only live in the tcbs, so
+// they still come through the PS svc, switch counts and the system load are
+// read from the kernel data page
 void ps(PS_DATA* psInfo)
 {
     __asm(" SVC #20");
-    putsUart0("\n  TASK   \tCPU %   \tMEMORY   \tSTATE      \t\tMUTEX   \tSEMAPHORE\n");
-    putsUart0("----------------------------------------------------------------------------------------------------\n");
+    putsUart0("\n  TASK   \t1s %  \t10s % \t60s % \tCPU ms    \tSWITCHES  \tMEMORY   \tPEAK/REC   \tSTATE      \t\tMUTEX   \tSEMAPHORE\n");
+    putsUart0("------------------------------------------------------------------------------------------------------------------------------------------------------------\n");
     char data[NAME_SIZE];
-    uint8_t i;
+    uint8_t i, j;
+    uint16_t load[LOAD_WINDOWS];
+    KDATA_TASK stats;
     for (i = 0; i < MAX_PS_DATA; i++)
     {
         if (psInfo[i].isData == true)
         {
-            putsUart0(psInfo[i].taskName); putsUart0("    \t"); putsUart0(numToStr(psInfo[i].cpuPercent / 100, data));
-            putcUart0('.'); putsUart0(numToStr(psInfo[i].cpuPercent % 100, data)); putsUart0("      \t");
-            putsUart0(numToStr(psInfo[i].memory, data)); putsUart0("B    \t"); putsUart0(psInfo[i].state); putsUart0(" \t");
+            putsUart0(psInfo[i].taskName); putsUart0("    \t");
+            for (j = 0; j < LOAD_WINDOWS; j++)
+            {
+                printLoad(psInfo[i].load[j]); putsUart0("  \t");
+            }
+            putsUart0(numToStr((uint32_t)(psInfo[i].runCycles / 40000), data)); putsUart0("      \t");
+            putsUart0(numToStr(getTaskStats(i, &stats) ? stats.dispatches : 0, data)); putsUart0("      \t");
+            putsUart0(numToStr(psInfo[i].memory, data)); putsUart0("B    \t");
+            putsUart0(numToStr(psInfo[i].stackPeak, data)); putcUart0('/');
+            putsUart0(numToStr(psInfo[i].stackRecommended, data)); putsUart0("B  \t");
+            putsUart0(psInfo[i].state); putsUart0(" \t");
             putsUart0(psInfo[i].mutex); putsUart0("    \t"); putsUart0(psInfo[i].semaphore); putcUart0('\n');
         }
         else
             break;
     }
+    getSystemLoad(load);
+    putsUart0("System  \t");
+    for (j = 0; j < LOAD_WINDOWS; j++)
+    {
+        printLoad(load[j]); putsUart0("  \t");
+    }
+    putcUart0('\n');
 }
 
 /**
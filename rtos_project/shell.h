@@ -19,8 +19,11 @@ typedef struct _PS_DATA
 {
     bool     isData;
     char     taskName[NAME_SIZE];
-    uint16_t cpuPercent;
+    uint16_t load[LOAD_WINDOWS];   // 1, 10, 60 s cpu load, LOAD_FIXED_1 = 100%
+    uint64_t runCycles;            // clocks run since the task was created
     uint16_t memory;
+    uint16_t stackPeak;            // most stack bytes ever used
+    uint16_t stackRecommended;     // peak plus margin, rounded to 512 B
     char     state[NAME_SIZE];
     char     mutex[NAME_SIZE];
     char     semaphore[NAME_SIZE];
@@ -0,0 +1,144 @@
+// Per task small object heap functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "subheap.h"
+#include "kernel.h"
+#include "kdata.h"
+#include "asm_src.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// the kernel allocates the window, opens it for the task and records the base
+// in the task's kdata slot, returns 0 if the heap is out of room
+static SUBHEAP* reserveSubheap(void)
+{
+    __asm(" SVC #34");
+    return (SUBHEAP*)reg0();
+}
+
+static SUBHEAP* getSubheap(void)
+{
+    SUBHEAP* heap = (SUBHEAP*)kdata.task[getTaskCurrent()].subheap;
+    uint8_t i;
+    if (heap)
+        return heap;
+    heap = reserveSubheap();
+    if (heap)
+    {
+        for (i = 0; i < SUBHEAP_PAGES; i++)
+        {
+            heap->pageClass[i] = 0;
+            heap->pageUsed[i] = 0;
+        }
+        heap->pageClass[0] = SUBHEAP_CLASSES + 1;   // header page, never carved
+        for (i = 0; i < SUBHEAP_CLASSES; i++)
+        {
+            heap->freeList[i] = 0;
+            heap->used[i] = 0;
+            heap->peak[i] = 0;
+        }
+    }
+    return heap;
+}
+
+// a free page is split into blocks of the class, all pushed on its free list
+static bool carvePage(SUBHEAP* heap, uint8_t class)
+{
+    uint8_t page;
+    uint16_t blockSize = SUBHEAP_MIN << class;
+    uint16_t offset;
+    for (page = 1; page < SUBHEAP_PAGES && heap->pageClass[page] != 0; page++);
+    if (page == SUBHEAP_PAGES)
+        return false;
+    heap->pageClass[page] = class + 1;
+    for (offset = (page + 1) * SUBHEAP_PAGE - blockSize; offset >= page * SUBHEAP_PAGE; offset -= blockSize)
+    {
+        *(uint16_t*)((uint8_t*)heap + offset) = heap->freeList[class];
+        heap->freeList[class] = offset;
+    }
+    return true;
+}
+
+// an empty page goes back to the pool of free pages, so a burst of one size
+// does not keep the pages from the other classes, bounded by the blocks on
+// the class list
+static void releasePage(SUBHEAP* heap, uint8_t page)
+{
+    uint8_t class = heap->pageClass[page] - 1;
+    uint16_t* link = &heap->freeList[class];
+    while (*link)
+    {
+        if (*link / SUBHEAP_PAGE == page)
+            *link = *(uint16_t*)((uint8_t*)heap + *link);
+        else
+            link = (uint16_t*)((uint8_t*)heap + *link);
+    }
+    heap->pageClass[page] = 0;
+}
+
+// larger requests go to the kernel heap through mallocRequest, they are then
+// not released by subFree
+void* subMalloc(uint32_t size)
+{
+    SUBHEAP* heap;
+    uint8_t class = 0;
+    uint16_t offset;
+    if (size == 0 || size > SUBHEAP_MAX)
+    {
+        void* p = 0;
+        if (size)
+            mallocRequest(size, &p);
+        return p;
+    }
+    while ((SUBHEAP_MIN << class) < size)
+        class++;
+    heap = getSubheap();
+    if (!heap)
+        return 0;
+    if (heap->freeList[class] == 0 && !carvePage(heap, class))
+        return 0;
+    offset = heap->freeList[class];
+    heap->freeList[class] = *(uint16_t*)((uint8_t*)heap + offset);
+    heap->pageUsed[offset / SUBHEAP_PAGE]++;
+    if (++heap->used[class] > heap->peak[class])
+        heap->peak[class] = heap->used[class];
+    return (uint8_t*)heap + offset;
+}
+
+// pointers outside the window, into a free page, off a block boundary or into
+// a page with nothing handed out are ignored
+void subFree(void* p)
+{
+    SUBHEAP* heap = (SUBHEAP*)kdata.task[getTaskCurrent()].subheap;
+    uint32_t offset;
+    uint8_t page, class;
+    if (!heap || (uint8_t*)p < (uint8_t*)heap + SUBHEAP_PAGE || (uint8_t*)p >= (uint8_t*)heap + SUBHEAP_SIZE)
+        return;
+    offset = (uint8_t*)p - (uint8_t*)heap;
+    page = offset / SUBHEAP_PAGE;
+    if (heap->pageClass[page] == 0 || heap->pageClass[page] > SUBHEAP_CLASSES)
+        return;
+    class = heap->pageClass[page] - 1;
+    if (offset % (SUBHEAP_MIN << class) != 0 || heap->pageUsed[page] == 0)
+        return;
+    *(uint16_t*)p = heap->freeList[class];
+    heap->freeList[class] = offset;
+    heap->used[class]--;
+    if (--heap->pageUsed[page] == 0)
+        releasePage(heap, page);
+}
@@ -0,0 +1,48 @@
+// Per task small object heap functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef SUBHEAP_H_
+#define SUBHEAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//-----------------------------------------------------------------------------
+// Sub-heap
+//-----------------------------------------------------------------------------
+
+// one heap allocation per task, reserved on the first small request and
+// carved in user mode, so later requests need no svc and no MPU change
+#define SUBHEAP_SIZE     1024
+#define SUBHEAP_PAGE     128           // a page holds blocks of one class only
+#define SUBHEAP_PAGES    (SUBHEAP_SIZE / SUBHEAP_PAGE)
+#define SUBHEAP_CLASSES  4             // 16, 32, 64 and 128 B blocks
+#define SUBHEAP_MIN      16
+#define SUBHEAP_MAX      (SUBHEAP_MIN << (SUBHEAP_CLASSES - 1))
+
+// kept in page 0 of the window, offsets are from the window base, 0 is none
+typedef struct _SUBHEAP
+{
+    uint8_t  pageClass[SUBHEAP_PAGES];   // class + 1, 0 for a free page, page 0 is this header
+    uint8_t  pageUsed[SUBHEAP_PAGES];    // blocks handed out from the page
+    uint16_t freeList[SUBHEAP_CLASSES];  // first free block of each class
+    uint16_t used[SUBHEAP_CLASSES];      // blocks handed out per class
+    uint16_t peak[SUBHEAP_CLASSES];      // most blocks ever handed out per class
+} SUBHEAP;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// user side, the calling task's own heap, no locking as no other task uses it
+void* subMalloc(uint32_t size);
+void subFree(void* p);
+
+#endif
@@ -20,6 +20,9 @@
 #include "kernel.h"
 #include "tasks.h"
 #include "mm.h"
+#include "nvic.h"
+#include "vtable.h"
+#include "workq.h"
 
 #define BLUE_LED   PORTF,2 // on-board blue LED
 #define RED_LED    PORTA,2 // off-board red LED
@@ -27,6 +30,9 @@
 #define YELLOW_LED PORTA,4 // off-board yellow LED
 #define GREEN_LED  PORTE,0 // off-board green LED
 
+#define PORTC_PB_PINS 0xF0 // PC4-7
+#define PORTD_PB_PINS 0xC0 // PD6-7
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -80,6 +86,53 @@ void initHw(void)
     NVIC_SYS_HND_CTRL_R |= NVIC_SYS_HND_CTRL_USAGE | NVIC_SYS_HND_CTRL_BUS | NVIC_SYS_HND_CTRL_MEM;
 }
 
+// bottom half, runs in the worker task
+void pbWork(uint32_t arg)
+{
+    post(keyDown);
+}
+
+// top half, masks the buttons until readKeys re-arms them so bounces do not
+// flood the work queue
+void pbIsr(void)
+{
+    GPIO_PORTC_IM_R &= ~PORTC_PB_PINS;
+    GPIO_PORTD_IM_R &= ~PORTD_PB_PINS;
+    GPIO_PORTC_ICR_R = PORTC_PB_PINS;
+    GPIO_PORTD_ICR_R = PORTD_PB_PINS;
+    queueWorkFromIsr(pbWork, 0);
+}
+
+// falling edge on any button, call after initVectorTable, stays masked until
+// readKeys arms it
+void initPbInterrupts(void)
+{
+    GPIO_PORTC_IM_R &= ~PORTC_PB_PINS;
+    GPIO_PORTD_IM_R &= ~PORTD_PB_PINS;
+    GPIO_PORTC_IS_R &= ~PORTC_PB_PINS;              // edge
+    GPIO_PORTD_IS_R &= ~PORTD_PB_PINS;
+    GPIO_PORTC_IBE_R &= ~PORTC_PB_PINS;             // single edge
+    GPIO_PORTD_IBE_R &= ~PORTD_PB_PINS;
+    GPIO_PORTC_IEV_R &= ~PORTC_PB_PINS;             // falling, buttons pull low
+    GPIO_PORTD_IEV_R &= ~PORTD_PB_PINS;
+    attachIsr(INT_GPIOC, pbIsr, true);
+    attachIsr(INT_GPIOD, pbIsr, true);
+    setNvicInterruptPriority(INT_GPIOC, KERNEL_INT_PRIORITY + 2);
+    setNvicInterruptPriority(INT_GPIOD, KERNEL_INT_PRIORITY + 2);
+    enableNvicInterrupt(INT_GPIOC);
+    enableNvicInterrupt(INT_GPIOD);
+}
+
+// drops edges latched while masked, the caller reads the pins right after so
+// a press in between is still seen
+void armPbInterrupts(void)
+{
+    GPIO_PORTC_ICR_R = PORTC_PB_PINS;
+    GPIO_PORTD_ICR_R = PORTD_PB_PINS;
+    GPIO_PORTC_IM_R |= PORTC_PB_PINS;
+    GPIO_PORTD_IM_R |= PORTD_PB_PINS;
+}
+
 // REQUIRED: add code to return a value from 0-63 indicating which of 6 PBs are pressed
 uint8_t readPbs(void)
 {
@@ -174,8 +227,10 @@ void readKeys(void)
         buttons = 0;
         while (buttons == 0)
         {
+            armPbInterrupts();
             buttons = readPbs();
-            yield();
+            if (buttons == 0)
+                wait(keyDown);              // stale post from a bounce just loops
         }
         post(keyPressed);
         if ((buttons & 1) != 0)
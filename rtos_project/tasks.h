@@ -16,6 +16,10 @@
 //-----------------------------------------------------------------------------
 
 void initHw(void);
+void initPbInterrupts(void);
+void armPbInterrupts(void);
+void pbIsr(void);
+void pbWork(uint32_t arg);
 void idleDos(void);
 void idle(void);
 void flash4Hz(void);
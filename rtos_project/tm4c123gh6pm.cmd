@@ -40,6 +40,8 @@ SECTIONS
     .bss    :   > SRAM
     .sysmem :   > SRAM
     .stack  :   > SRAM
+    .crash  :   > 0x20000E00, type = NOINIT
+    .kdata  :   > 0x20000F00, type = NOINIT
 
     .pstack :	> 0x20001000
 }
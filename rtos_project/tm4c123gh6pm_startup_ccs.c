@@ -23,6 +23,7 @@
 //*****************************************************************************
 
 #include <stdint.h>
+#include "heapplan.h"
 
 //*****************************************************************************
 //
@@ -66,11 +67,12 @@ extern void systickIsr(void);
 //*****************************************************************************
 //
 // For RTOS, process stack initialized for creating tasks in this space. So the
-// processor don't access this addresses. 28 KB (0x20001000 - 0x2007FFF)
+// processor don't access this addresses. PSTACK_ADDRESS to the end of SRAM,
+// 28 KB (0x20001000 - 0x2007FFF) on the TM4C123, see heapplan.h
 //
 //*****************************************************************************
 #pragma DATA_SECTION(processStack, ".pstack")
-char processStack[28 * 1024] = {0};
+char processStack[SRAM_END - PSTACK_ADDRESS] = {0};
 
 //*****************************************************************************
 //
@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+# Decodes a captured 'crash' dump, symbolized against the linker map
+# Deep Shinglot
+#
+# usage: crashdecode.py capture.txt [Debug/rtos_project.map]
+#
+# capture is the raw UART text, lines that are not part of the dump are ignored
+#   T <type> <task> <tickHi> <tickLo> <count> <name>
+#   F <cfsr> <hfsr> <address> <psp>
+#   R <r0> <r1> <r2> <r3> <r12> <lr> <pc> <xpsr>
+#   E <cycles> <info>           newest trace events, oldest first
+#   S <address> <value>         stack snapshot from the faulting sp up
+#   B <address>                 backtrace, innermost first
+# all numbers in hex, the B lines printed live by the fault handler work alone
+
+import os
+import sys
+
+from symbolize import DEFAULT_MAP, load_symbols, symbolize
+from trace2json import CLOCK_MHZ, describe
+
+# must match faults.h
+FAULT_TYPES = ["MPU", "Hard", "Bus", "Usage"]
+
+# NVIC_FAULT_STAT_R, MMFSR 7:0, BFSR 15:8, UFSR 31:16
+CFSR_BITS = [
+    (0x00000001, "IERR instruction access violation"),
+    (0x00000002, "DERR data access violation"),
+    (0x00000008, "MUSTKE unstacking violation"),
+    (0x00000010, "MSTKE stacking violation"),
+    (0x00000020, "MLSPERR lazy fp state violation"),
+    (0x00000080, "MMARV fault address valid"),
+    (0x00000100, "IBUS instruction bus error"),
+    (0x00000200, "PRECISE data bus error"),
+    (0x00000400, "IMPRE imprecise data bus error"),
+    (0x00000800, "BUSTKE unstacking bus fault"),
+    (0x00001000, "BSTKE stacking bus fault"),
+    (0x00002000, "BLSPERR lazy fp state bus fault"),
+    (0x00008000, "BFARV fault address valid"),
+    (0x00010000, "UNDEF undefined instruction"),
+    (0x00020000, "INVSTAT invalid state"),
+    (0x00040000, "INVPC invalid pc load"),
+    (0x00080000, "NOCP no coprocessor"),
+    (0x01000000, "UNALIGN unaligned access"),
+    (0x02000000, "DIV0 divide by zero"),
+]
+HFSR_BITS = [
+    (0x00000002, "VECT vector table read"),
+    (0x40000000, "FORCED escalated from a configurable fault"),
+    (0x80000000, "DBG debug event"),
+]
+
+REGS = ["R0", "R1", "R2", "R3", "R12", "LR", "PC", "xPSR"]
+
+
+def words(fields):
+    return [int(x, 16) for x in fields]
+
+
+def parse(lines):
+    crash = {"trace": [], "stack": [], "backtrace": []}
+    for line in lines:
+        fields = line.split()
+        if not fields:
+            continue
+        try:
+            if fields[0] == "T" and len(fields) >= 7:
+                values = words(fields[1:6])
+                crash["type"], crash["task"] = values[0], values[1]
+                crash["tick"] = (values[2] << 32) | values[3]
+                crash["count"] = values[4]
+                crash["name"] = " ".join(fields[6:])
+            elif fields[0] == "F" and len(fields) == 5:
+                crash["cfsr"], crash["hfsr"], crash["address"], crash["psp"] = words(fields[1:])
+            elif fields[0] == "R" and len(fields) == 9:
+                crash["regs"] = words(fields[1:])
+            elif fields[0] == "E" and len(fields) == 3:
+                crash["trace"].append(tuple(words(fields[1:])))
+            elif fields[0] == "S" and len(fields) == 3:
+                crash["stack"].append(tuple(words(fields[1:])))
+            elif fields[0] == "B" and len(fields) == 2:
+                crash["backtrace"].append(int(fields[1], 16))
+        except ValueError:
+            continue
+    return crash
+
+
+def print_backtrace(backtrace, where):
+    # pc first, then lr and the return addresses the scan found, a stale one
+    # from a call that already returned can be mixed in
+    print("backtrace")
+    for depth, address in enumerate(backtrace):
+        print("  #%d 0x%08X  %s" % (depth, address, where(address)))
+
+
+def is_code(value):
+    return (value & 1) and value < 0x00040000
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: crashdecode.py capture.txt [rtos_project.map]")
+        return 1
+    with open(sys.argv[1], errors="replace") as f:
+        crash = parse(f)
+    if "regs" not in crash and not crash["backtrace"]:
+        print("no crash record or backtrace found")
+        return 1
+    map_path = sys.argv[2] if len(sys.argv) > 2 else DEFAULT_MAP
+    symbols = load_symbols(map_path) if os.path.exists(map_path) else []
+    starts = [address for address, _ in symbols]
+
+    def where(value):
+        return symbolize(symbols, starts, value) if symbols else "0x%08X" % value
+
+    if "regs" not in crash:
+        print_backtrace(crash["backtrace"], where)
+        return 0
+
+    print("%s fault in %s (task %d), tick %d ms, %d fault(s) since clear"
+          % (FAULT_TYPES[crash["type"]] if crash["type"] < len(FAULT_TYPES) else crash["type"],
+             crash["name"], crash["task"], crash["tick"], crash["count"]))
+    print("CFSR 0x%08X" % crash["cfsr"])
+    for bit, text in CFSR_BITS:
+        if crash["cfsr"] & bit:
+            print("    " + text)
+    print("HFSR 0x%08X" % crash["hfsr"])
+    for bit, text in HFSR_BITS:
+        if crash["hfsr"] & bit:
+            print("    " + text)
+    if crash["address"]:
+        print("fault address 0x%08X" % crash["address"])
+    print("PSP 0x%08X" % crash["psp"])
+    print()
+    for name, value in zip(REGS, crash["regs"]):
+        line = "%-5s 0x%08X" % (name, value)
+        if name in ("PC", "LR"):
+            line += "  " + where(value)
+        print(line)
+
+    if crash["trace"]:
+        print()
+        print("last trace events")
+        first = crash["trace"][0][0]
+        for cycles, info in crash["trace"]:
+            print("  %+10.1f us  task %-2d %s" % (((cycles - first) & 0xFFFFFFFF) / CLOCK_MHZ,
+                                                (info >> 16) & 0xFF,
+                                                describe(info >> 24, info & 0xFFFF)))
+    if crash["stack"]:
+        print()
+        print("stack")
+        for address, value in crash["stack"]:
+            line = "  0x%08X  0x%08X" % (address, value)
+            if is_code(value):
+                line += "  " + where(value)
+            print(line)
+    if crash["backtrace"]:
+        print()
+        print_backtrace(crash["backtrace"], where)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+# Generates heapplan.h, the MPU region plan of the task heap, from the linker
+# command file
+# Deep Shinglot
+#
+# usage: heapplan.py [tm4c123gh6pm.cmd] [heapplan.h]
+#
+# the heap runs from the .pstack placement to the end of the SRAM block in
+# MEMORY, it is cut into naturally aligned power of two MPU regions, at most
+# HEAP_MPU_REGIONS of them, as each region's 8 subregions are what a task's
+# srd mask grants, spare regions go to halving the largest ones (lowest address
+# first) so more of the heap has small subregions
+#
+# a range that needs more regions than there are loses its smallest end
+# pieces, which stay unused, and a warning says how much
+#
+# the plan never has more than 40 subregions, a task's srd mask can only
+# grant the 8 subregions of each of the 5 regions, so a larger SRAM gets larger
+# subregions, not more of them: allocations (and so tasks) stay capped at 40,
+# the smallest allocation costs a whole subregion (16 KB on a 256 KB part) and
+# stacks that land on subregions above STACK_GUARD_MAX run without a guard,
+# going past that needs the MPU reprogrammed per task on every switch
+
+import re
+import sys
+
+HEAP_MPU_REGIONS = 5            # MPU regions 3-7, 0-2 are flash, peripherals, kdata
+FIRST_MPU_REGION = 3
+MIN_REGION = 256                # 32 B subregions are too small to be useful
+STACK_GUARD_MAX = 1024          # kernel.c, larger subregions are not spent on a guard
+
+
+def read_layout(path):
+    text = open(path, errors="replace").read()
+    sram = re.search(r"SRAM\s*\([A-Z]*\)\s*:\s*origin\s*=\s*(0x[0-9A-Fa-f]+)\s*,\s*length\s*=\s*(0x[0-9A-Fa-f]+)", text)
+    pstack = re.search(r"\.pstack\s*:\s*>\s*(0x[0-9A-Fa-f]+)", text)
+    if not sram or not pstack:
+        raise SystemExit("%s: needs an SRAM line in MEMORY and a .pstack placement" % path)
+    origin, length = int(sram.group(1), 16), int(sram.group(2), 16)
+    return origin, origin + length, int(pstack.group(1), 16)
+
+
+def decompose(start, end):
+    # largest aligned power of two blocks, in address order
+    blocks = []
+    while end - start >= MIN_REGION:
+        size = MIN_REGION
+        while start % (size * 2) == 0 and start + size * 2 <= end:
+            size *= 2
+        if start % size:
+            start += MIN_REGION - start % MIN_REGION
+            continue
+        blocks.append([start, size])
+        start += size
+    return blocks
+
+
+def plan(start, end):
+    blocks = decompose(start, end)
+    dropped = 0
+    while len(blocks) > HEAP_MPU_REGIONS:
+        # only the ends can go, the allocator needs one contiguous range
+        victim = 0 if blocks[0][1] <= blocks[-1][1] else -1
+        dropped += blocks.pop(victim)[1]
+    while len(blocks) < HEAP_MPU_REGIONS:
+        largest = max(size for _, size in blocks)
+        if largest < MIN_REGION * 2:
+            break
+        i = next(i for i, (_, size) in enumerate(blocks) if size == largest)
+        base, size = blocks[i]
+        blocks[i:i + 1] = [[base, size // 2], [base + size // 2, size // 2]]
+    return blocks, dropped
+
+
+def main():
+    cmd = sys.argv[1] if len(sys.argv) > 1 else "tm4c123gh6pm.cmd"
+    out = sys.argv[2] if len(sys.argv) > 2 else "heapplan.h"
+    sram_start, sram_end, heap_start = read_layout(cmd)
+    blocks, dropped = plan(heap_start, sram_end)
+    if not blocks:
+        raise SystemExit("no heap between 0x%08X and 0x%08X" % (heap_start, sram_end))
+    if dropped:
+        print("warning: %d B of the heap does not fit %d MPU regions and is left unused"
+              % (dropped, HEAP_MPU_REGIONS), file=sys.stderr)
+    sizes = sorted(set(size // 8 for _, size in blocks))
+    if sizes[-1] > STACK_GUARD_MAX:
+        print("warning: %d B subregions, each allocation takes at least %d B and stacks placed"
+              " above %d B subregions run unguarded" % (sizes[-1], sizes[0], STACK_GUARD_MAX), file=sys.stderr)
+    lines = [
+        "// Heap region plan",
+        "// generated by tools/heapplan.py from %s, do not edit" % cmd.replace("\\", "/").split("/")[-1],
+        "",
+        "#ifndef HEAPPLAN_H_",
+        "#define HEAPPLAN_H_",
+        "",
+        "#define SRAM_ADDRESS 0x%08X" % sram_start,
+        "#define SRAM_END 0x%08X" % sram_end,
+        "#define PSTACK_ADDRESS 0x%08X" % heap_start,
+        "#define HEAP_ADDRESS 0x%08X" % blocks[0][0],
+        "#define HEAP_SIZE %d" % (blocks[-1][0] + blocks[-1][1] - blocks[0][0]),
+        "#define HEAP_END (HEAP_ADDRESS + HEAP_SIZE)",
+        "",
+        "// base, size, subregion size, MPU region, srd bit of subregion 0",
+        "#define NUM_HEAP_REGIONS %d" % len(blocks),
+        "#define HEAP_REGION_LIST \\",
+        "{ \\",
+    ]
+    for n, (base, size) in enumerate(blocks):
+        lines.append("    {0x%08X, %6d, %5d, %d, %2d}, \\" % (base, size, size // 8, FIRST_MPU_REGION + n, 8 * (n + 1)))
+    lines += [
+        "}",
+        "",
+        "// distinct subregion sizes, smallest first, %d subregions in all, the most" % (8 * len(blocks)),
+        "// allocations and tasks a plan can hold whatever the SRAM size",
+        "#define NUM_SUBREGION_SIZES %d" % len(sizes),
+        "#define SUBREGION_SIZE_LIST {%s}" % ", ".join(str(s) for s in sizes),
+        "",
+        "#endif",
+        "",
+    ]
+    with open(out, "w") as f:
+        f.write("\n".join(lines))
+    for base, size in blocks:
+        print("0x%08X %6d B, %5d B subregions" % (base, size, size // 8))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
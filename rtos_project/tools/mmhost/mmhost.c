@@ -0,0 +1,427 @@
+// Host build of the heap allocator, regression cases, fuzzer and benchmark,
+// plus a save and reload of the crash record through its host file
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target:          Linux host, mm.c and crash.c built with HOST_SIM against mpu_sim.h
+//
+// build from rtos_project:
+//   gcc -O2 -DHOST_SIM -Itools/mmhost -I. -Wno-int-to-pointer-cast
+//       -Wno-pointer-to-int-cast tools/mmhost/mmhost.c mm.c crash.c c_fnc.c -o mmhost
+// usage:
+//   mmhost                     regression cases, crash record, then a short fuzz
+//   mmhost fuzz [ops] [seed]   random alloc/resize/free/kill, invariants after each op
+//   mmhost bench [ops] [seed]  latency, failures and fragmentation over a trace
+// add -include <dir>/heapplan.h to run against the plan of another board, the
+// mini project cases expect the TM4C123 plan and are skipped for any other
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mpu_sim.h"
+#include "mm.h"
+#include "kdata.h"
+#include "crash.h"
+
+// what mm.c and crash.c keep to themselves on the target
+extern uint64_t heapInUse;
+uint16_t subregionSizeAt(uint8_t index);
+uint32_t subregionAddress(uint8_t index);
+extern CRASH_RECORD crashRecord;
+bool crashValid(void);
+
+// kernel pieces mm.c links against
+KDATA kdata;
+uint32_t mpuSimNumber;
+uint32_t mpuSimBase[MPU_SIM_REGIONS];
+uint32_t mpuSimAttr[MPU_SIM_REGIONS];
+
+void traceEvent(uint8_t type, uint8_t task, uint16_t data)
+{
+}
+
+uint8_t traceLast(TRACE_EVENT events[], uint8_t max)
+{
+    return 0;
+}
+
+void putsUart0(char* str)
+{
+    fputs(str, stdout);
+}
+
+void putcUart0(char c)
+{
+    putchar(c);
+}
+
+// shadow of what should be live, checked against mm.c after every operation
+typedef struct _LIVE
+{
+    uint32_t base;
+    uint32_t size;
+    uint8_t owner;
+} LIVE;
+
+LIVE live[MAX_MEMORY_ALLOCATION];
+uint8_t liveCount;
+uint32_t heapSize;
+uint32_t failures;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void fail(const char* what, uint32_t op)
+{
+    printf("FAIL op %u: %s\n", op, what);
+    failures++;
+}
+
+void resetHeap(void)
+{
+    while (liveCount)
+        freeToHeap((void*)live[--liveCount].base);
+}
+
+uint32_t alloc(uint32_t size, uint8_t owner)
+{
+    uint32_t base = (uint32_t)mallocFromHeap(size);
+    if (base)
+    {
+        if (owner != NO_OWNER)
+            setAllocationOwner((void*)base, owner);
+        live[liveCount].base = base;
+        live[liveCount].size = size;
+        live[liveCount++].owner = owner;
+    }
+    return base;
+}
+
+void release(uint8_t i)
+{
+    freeToHeap((void*)live[i].base);
+    live[i] = live[--liveCount];
+}
+
+// srd bits of the subregions [base, base + size) touches, worked out from the
+// subregion addresses rather than through calculateIndex
+uint64_t expectedWindow(uint32_t base, uint32_t size)
+{
+    uint64_t bits = 0;
+    uint8_t i;
+    for (i = SRD_INDEX_HEAP; i < SRD_INDEX_END; i++)
+    {
+        uint32_t start = subregionAddress(i);
+        if (start < base + size && start + subregionSizeAt(i) > base)
+            bits |= (uint64_t)1 << i;
+    }
+    return bits;
+}
+
+uint32_t windowBytes(uint64_t bits)
+{
+    uint32_t bytes = 0;
+    uint8_t i;
+    for (i = SRD_INDEX_HEAP; i < SRD_INDEX_END; i++)
+        if (bits & ((uint64_t)1 << i))
+            bytes += subregionSizeAt(i);
+    return bytes;
+}
+
+// every live allocation starts on a subregion, its srd window is exactly the
+// subregions it touches, windows do not overlap, their union is heapInUse, the
+// free count matches, the registry agrees and the MPU holds the mask written
+void checkInvariants(uint32_t op)
+{
+    uint64_t all = 0;
+    uint8_t i, task;
+    uint8_t listed = 0, owned = 0;
+    for (i = 0; i < liveCount; i++)
+    {
+        uint64_t mask = createNoSramAccessMask();
+        uint64_t expected = expectedWindow(live[i].base, live[i].size);
+        uint8_t r;
+        addSramAccessWindow(&mask, (uint32_t*)live[i].base, live[i].size);
+        if (subregionAddress(__builtin_ctzll(expected)) != live[i].base)
+            fail("allocation does not start on a subregion", op);
+        if (~mask != expected)
+            fail("srd window differs from the allocation", op);
+        if (all & expected)
+            fail("allocations overlap", op);
+        all |= expected;
+        if (allocationSize((void*)live[i].base) != live[i].size)
+            fail("registry size differs", op);
+        if (allocationOwner((void*)live[i].base) != live[i].owner)
+            fail("registry owner differs", op);
+        if (live[i].owner != NO_OWNER)
+            owned++;
+        applySramAccessMask(mask);
+        for (r = SRD_INDEX_HEAP / 8; r < SRD_INDEX_END / 8; r++)
+            if (((mpuSimAttr[r + 2] >> 8) & 0xFF) != (uint8_t)(mask >> (8 * r))
+                    || !(mpuSimAttr[r + 2] & NVIC_MPU_ATTR_ENABLE))
+                fail("mpu srd field differs from the mask", op);
+    }
+    if (all != heapInUse)
+        fail("heapInUse differs from the live windows", op);
+    if (getFreeSpace() != heapSize - windowBytes(all))
+        fail("free space accounting drifted", op);
+    for (task = 0; task < MAX_TASKS; task++)
+        for (i = taskAllocations[task]; i != NO_ALLOCATION && listed <= MAX_MEMORY_ALLOCATION; i = allocatedData[i].next)
+            listed++;
+    if (listed != owned)
+        fail("task lists differ from the owned allocations", op);
+}
+
+// the mini project sequences on an empty heap, the first expected requests
+// must succeed and the rest fail for want of space
+bool runSequence(const char* name, const uint32_t sizes[], uint8_t count, uint8_t expected)
+{
+    uint8_t i, ok = 0;
+    bool inOrder = true;
+    for (i = 0; i < count; i++)
+    {
+        bool got = alloc(sizes[i], NO_OWNER) != 0;
+        inOrder = inOrder && (got == (i < expected));
+        ok += got;
+    }
+    checkInvariants(0);
+    printf("%-16s %2u/%2u allocated, %5u B free\n", name, ok, count, getFreeSpace());
+    resetHeap();
+    return inOrder;
+}
+
+void regression(void)
+{
+    static const uint32_t testing1[] = {512, 512, 512, 512, 512, 512, 512, 512, 512, 512, 512, 512, 512,
+                                        512, 512, 512, 512, 512, 512, 512, 512, 512, 512, 512, 512, 1024, 1500};
+    static const uint32_t testing2[] = {1500, 1500, 1500, 1500, 1500, 8000, 6000};
+    static const uint32_t testing3[] = {8000, 8000, 8000, 4000, 4000, 4000, 1};   // heap full after 4
+    uint32_t first, last;
+    if (!runSequence("mallocTesting1", testing1, sizeof(testing1) / sizeof(uint32_t), 27))
+        fail("mallocTesting1", 0);
+    if (!runSequence("mallocTesting2", testing2, sizeof(testing2) / sizeof(uint32_t), 7))
+        fail("mallocTesting2", 0);
+    if (!runSequence("mallocTesting3", testing3, sizeof(testing3) / sizeof(uint32_t), 4))
+        fail("mallocTesting3", 0);
+
+    // freeTesting, freed space is handed out again
+    first = alloc(2000, NO_OWNER);
+    alloc(3000, NO_OWNER);
+    release(0);
+    alloc(1000, NO_OWNER);
+    last = alloc(1200, NO_OWNER);
+    release(liveCount - 1);
+    if (!first || !last || alloc(1200, NO_OWNER) != last)
+        fail("freeTesting", 0);
+    checkInvariants(0);
+    printf("%-16s %5u B free\n", "freeTesting", getFreeSpace());
+    resetHeap();
+
+    // 1536 B fills three 512 B subregions or two 1024 B ones, never spills
+    // into a fourth, and its last byte is inside the window
+    last = alloc(1536, NO_OWNER);
+    if (!last || windowBytes(expectedWindow(last, 1536)) > 2048)
+        fail("1536 B edge", 0);
+    checkInvariants(0);
+    resetHeap();
+
+    // grows into the free subregions above, shrinks back, refuses to grow
+    // over a neighbour
+    first = alloc(512, NO_OWNER);
+    if (!resizeInHeap((void*)first, 1536) || !resizeInHeap((void*)first, 100))
+        fail("resize in place", 0);
+    live[0].size = 100;
+    last = alloc(512, NO_OWNER);
+    if (last == first + 512 && resizeInHeap((void*)first, 1024))
+        fail("resize over a neighbour", 0);
+    checkInvariants(0);
+    resetHeap();
+
+    // nothing for 0 bytes or more than the heap, full registry fails cleanly
+    if (mallocFromHeap(0) || mallocFromHeap(heapSize + 1))
+        fail("bad size accepted", 0);
+    while (alloc(1, NO_OWNER));
+    if (liveCount != SRD_INDEX_END - SRD_INDEX_HEAP || getFreeSpace() != 0)
+        fail("heap of single byte requests not full", 0);
+    checkInvariants(0);
+    resetHeap();
+}
+
+// a saved record comes back through the file with its magic and check, one
+// flipped byte in the file and it reads as empty
+void crashRoundTrip(void)
+{
+    FAULT_RECORD fault;
+    FILE* f;
+    memset(&fault, 0, sizeof(fault));
+    fault.type = FAULT_MPU;
+    fault.task = 3;
+    fault.cfsr = 0x82;
+    fault.address = 0x20001234;
+    remove(CRASH_FILE);
+    crashClear();
+    crashSave(&fault, "faulter", 0x10000000);      // sp outside sram, no stack words read
+    memset(&crashRecord, 0, sizeof(crashRecord));
+    initCrash();
+    if (!crashValid() || crashRecord.magic != CRASH_MAGIC || crashRecord.count != 1
+            || crashRecord.fault.address != 0x20001234 || strcmp(crashRecord.name, "faulter") != 0)
+        fail("crash record round trip", 0);
+    crashSave(&fault, "faulter", 0x10000000);
+    if (!crashValid() || crashRecord.count != 2)
+        fail("crash record count", 0);
+    f = fopen(CRASH_FILE, "r+b");
+    if (!f || fseek(f, offsetof(CRASH_RECORD, fault.cfsr), SEEK_SET) != 0 || fputc(0x83, f) == EOF)
+        fail("crash record file", 0);
+    if (f)
+        fclose(f);
+    initCrash();
+    if (crashValid() || crashRecord.count != 0)
+        fail("corrupt crash record accepted", 0);
+    remove(CRASH_FILE);
+    printf("%-16s saved, reloaded, corruption caught\n", "crashRecord");
+}
+
+// sizes are mostly small with a tail of stack sized requests
+uint32_t randomSize(void)
+{
+    if (rand() % 4 == 0)
+        return (rand() % 16 + 1) * 512;
+    return rand() % 4000 + 1;
+}
+
+void fuzz(uint32_t ops, uint32_t seed)
+{
+    uint32_t op;
+    srand(seed);
+    for (op = 1; op <= ops && failures < 10; op++)
+    {
+        int r = rand() % 100;
+        if (r < 50 || liveCount == 0)
+            alloc(randomSize(), (rand() % 4) ? rand() % MAX_TASKS : NO_OWNER);
+        else if (r < 65)
+        {
+            // in place or not at all, a refused resize must leave it as it was
+            uint8_t i = rand() % liveCount;
+            uint32_t size = randomSize();
+            if (resizeInHeap((void*)live[i].base, size))
+                live[i].size = size;
+        }
+        else if (r < 90)
+        {
+            uint8_t i = rand() % liveCount;
+            uint32_t base = live[i].base;
+            release(i);
+            freeToHeap((void*)base);                // double free is ignored
+        }
+        else
+        {
+            uint8_t task = rand() % MAX_TASKS, i = 0;
+            freeTaskAllocations(task);
+            while (i < liveCount)
+            {
+                if (live[i].owner == task)
+                    live[i] = live[--liveCount];
+                else
+                    i++;
+            }
+        }
+        checkInvariants(op);
+    }
+    resetHeap();
+    printf("fuzz %u ops, seed %u, %u failures\n", ops, seed, failures);
+}
+
+double nowNs(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+int compareDouble(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// failures are split into those with too few free bytes and those where the
+// bytes were there but not in one run
+void bench(uint32_t ops, uint32_t seed)
+{
+    double* mallocNs = malloc(ops * sizeof(double));
+    double freeNs = 0, t;
+    uint32_t op, allocs = 0, frees = 0, failed = 0, fragmented = 0;
+    uint64_t fragSum = 0;
+    HEAP_STATS stats;
+    srand(seed);
+    for (op = 0; op < ops; op++)
+    {
+        if ((rand() % 100 < 55 && liveCount < MAX_MEMORY_ALLOCATION) || liveCount == 0)
+        {
+            uint32_t size = randomSize();
+            uint32_t freeBytes = getFreeSpace();
+            t = nowNs();
+            uint32_t base = alloc(size, NO_OWNER);
+            mallocNs[allocs++] = nowNs() - t;
+            if (!base)
+            {
+                failed++;
+                if (freeBytes >= size)
+                    fragmented++;
+            }
+        }
+        else
+        {
+            uint8_t i = rand() % liveCount;
+            t = nowNs();
+            release(i);
+            freeNs += nowNs() - t;
+            frees++;
+        }
+        getHeapStats(&stats);
+        fragSum += stats.fragmentation;
+    }
+    qsort(mallocNs, allocs, sizeof(double), compareDouble);
+    printf("bench %u ops, seed %u\n", ops, seed);
+    printf("  malloc %u, p50 %.0f ns, p99 %.0f ns, max %.0f ns\n", allocs,
+           mallocNs[allocs / 2], mallocNs[allocs * 99 / 100], mallocNs[allocs - 1]);
+    printf("  free %u, avg %.0f ns\n", frees, frees ? freeNs / frees : 0);
+    printf("  failed %u (%.1f%%), %u with enough free bytes\n", failed, 100.0 * failed / allocs, fragmented);
+    printf("  fragmentation avg %.1f%%\n", (double)fragSum / ops);
+    resetHeap();
+    free(mallocNs);
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t ops = (argc > 2) ? strtoul(argv[2], 0, 0) : 0;
+    uint32_t seed = (argc > 3) ? strtoul(argv[3], 0, 0) : 1;
+    initRegistry();
+    setupSramAccess();
+    heapSize = getFreeSpace();
+    if (argc > 1 && strcmp(argv[1], "fuzz") == 0)
+        fuzz(ops ? ops : 100000, seed);
+    else if (argc > 1 && strcmp(argv[1], "bench") == 0)
+        bench(ops ? ops : 200000, seed);
+    else
+    {
+        if (HEAP_SIZE == 28672)
+            regression();
+        crashRoundTrip();
+        fuzz(20000, seed);
+    }
+    printf(failures ? "FAILED\n" : "PASSED\n");
+    return failures != 0;
+}
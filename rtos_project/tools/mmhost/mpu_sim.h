@@ -0,0 +1,28 @@
+// Host MPU register model
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target:          Linux host, stands in for tm4c123gh6pm.h in a HOST_SIM build
+
+#ifndef MPU_SIM_H_
+#define MPU_SIM_H_
+
+#include <stdint.h>
+
+// MPU number, base and attribute registers banked per region like the real
+// ones, so a harness can read back what applySramAccessMask wrote
+#define MPU_SIM_REGIONS 8
+
+extern uint32_t mpuSimNumber;
+extern uint32_t mpuSimBase[MPU_SIM_REGIONS];
+extern uint32_t mpuSimAttr[MPU_SIM_REGIONS];
+
+#define NVIC_MPU_NUMBER_R       mpuSimNumber
+#define NVIC_MPU_BASE_R         mpuSimBase[mpuSimNumber & (MPU_SIM_REGIONS - 1)]
+#define NVIC_MPU_ATTR_R         mpuSimAttr[mpuSimNumber & (MPU_SIM_REGIONS - 1)]
+#define NVIC_MPU_ATTR_ENABLE    0x00000001
+
+#endif
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+# Turns the heap records of captured 'meminfo' output into csv for trending
+# Deep Shinglot
+#
+# usage: mmstat.py capture.txt [more captures] > heap.csv
+#
+# capture is the raw UART text, lines outside '#mmstat begin/end' are ignored
+#   M <tickHi> <tickLo> <heapSize> <free> <requested> <wasted> <largest>
+#     <frag%> <allocations>
+#   L <subregionSize> <largestRun>   one per subregion size in the heap plan
+#   F <size> <noSpace> <fragmented> <registry>     failure counts since reset
+#   H <=64 <=128 <=256 <=512 <=1K <=2K <=4K <=8K >8K  request sizes since reset
+# all numbers in hex, one csv row per record, failure and request counts are
+# running totals, so a trend is the difference between rows
+
+import csv
+import sys
+
+# must match printHeapStats in kernel.c
+M_FIELDS = ["heap", "free", "requested", "wasted", "largest", "frag_pct",
+            "allocations"]
+F_FIELDS = ["fail_size", "fail_no_space", "fail_fragmented", "fail_registry"]
+H_FIELDS = ["req_le64", "req_le128", "req_le256", "req_le512", "req_le1k",
+            "req_le2k", "req_le4k", "req_le8k", "req_gt8k"]
+
+
+def read_records(path):
+    records = []
+    record = None
+    with open(path, errors="replace") as f:
+        for line in f:
+            fields = line.split()
+            if not fields:
+                continue
+            if fields[0] == "#mmstat":
+                if fields[1:2] == ["begin"]:
+                    record = {"capture": path}
+                elif record is not None and "tick_ms" in record:
+                    records.append(record)
+                    record = None
+                continue
+            if record is None:
+                continue
+            try:
+                values = [int(x, 16) for x in fields[1:]]
+            except ValueError:
+                continue
+            if fields[0] == "M" and len(values) == 2 + len(M_FIELDS):
+                record["tick_ms"] = (values[0] << 32) | values[1]
+                record.update(zip(M_FIELDS, values[2:]))
+            elif fields[0] == "L" and len(values) == 2:
+                record["largest_%d" % values[0]] = values[1]
+            elif fields[0] == "F" and len(values) == len(F_FIELDS):
+                record.update(zip(F_FIELDS, values))
+            elif fields[0] == "H" and len(values) == len(H_FIELDS):
+                record.update(zip(H_FIELDS, values))
+    return records
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: mmstat.py capture.txt [more captures]")
+        return 1
+    records = []
+    for path in sys.argv[1:]:
+        records.extend(read_records(path))
+    if not records:
+        print("no heap records found", file=sys.stderr)
+        return 1
+    # boards with another heap plan add their own largest_<size> columns
+    sizes = sorted(set(int(k[8:]) for r in records for k in r if k.startswith("largest_")))
+    columns = ["capture", "tick_ms"] + M_FIELDS + ["largest_%d" % s for s in sizes] + F_FIELDS + H_FIELDS
+    writer = csv.DictWriter(sys.stdout, columns)
+    writer.writeheader()
+    for record in records:
+        writer.writerow(record)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# Symbolizes a captured 'prof dump' against the linker map
+# Deep Shinglot
+#
+# usage: symbolize.py capture.txt [Debug/rtos_project.map]
+#
+# capture is the raw UART text, lines that are not part of the dump are ignored
+#   P <task> <pc> <count>   pc in hex, one line per bin
+# samples are summed per task and function, static functions do not appear in
+# the map so they are charged to the global function placed before them
+
+import bisect
+import sys
+from collections import defaultdict
+
+DEFAULT_MAP = "Debug/rtos_project.map"
+
+
+def load_symbols(path):
+    # "GLOBAL SYMBOLS: SORTED BY Symbol Address" section, "address  name" lines
+    symbols = []
+    in_section = False
+    with open(path, errors="replace") as f:
+        for line in f:
+            if line.startswith("GLOBAL SYMBOLS: SORTED BY Symbol Address"):
+                in_section = True
+                continue
+            if not in_section:
+                continue
+            if line.startswith("["):          # "[n symbols]" closes the section
+                break
+            fields = line.split()
+            if len(fields) != 2:
+                continue
+            try:
+                address = int(fields[0], 16)
+            except ValueError:
+                continue
+            # thumb functions have bit 0 set, data does not, keep code only
+            if address & 1 and address < 0x20000000:
+                symbols.append((address & ~1, fields[1]))
+    symbols.sort()
+    return symbols
+
+
+def symbolize(symbols, starts, pc):
+    i = bisect.bisect_right(starts, pc & ~1) - 1
+    if i < 0:
+        return "0x%08X" % pc
+    address, name = symbols[i]
+    return "%s+0x%X" % (name, (pc & ~1) - address)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: symbolize.py capture.txt [rtos_project.map]")
+        return 1
+    symbols = load_symbols(sys.argv[2] if len(sys.argv) > 2 else DEFAULT_MAP)
+    if not symbols:
+        print("no code symbols found in map")
+        return 1
+    starts = [address for address, _ in symbols]
+
+    by_function = defaultdict(int)
+    by_line = []
+    total = 0
+    with open(sys.argv[1], errors="replace") as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) != 4 or fields[0] != "P":
+                continue
+            task, pc, count = fields[1], int(fields[2], 16), int(fields[3])
+            where = symbolize(symbols, starts, pc)
+            by_function[(task, where.split("+")[0])] += count
+            by_line.append((count, task, where))
+            total += count
+    if total == 0:
+        print("no samples found")
+        return 1
+
+    print("%-12s %-28s %8s %7s" % ("TASK", "FUNCTION", "SAMPLES", "%"))
+    for (task, function), count in sorted(by_function.items(), key=lambda x: -x[1]):
+        print("%-12s %-28s %8d %6.2f" % (task, function, count, 100.0 * count / total))
+    print()
+    print("%-12s %-36s %8s" % ("TASK", "ADDRESS", "SAMPLES"))
+    for count, task, where in sorted(by_line, reverse=True)[:20]:
+        print("%-12s %-36s %8d" % (task, where, count))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+# Converts a captured 'trace dump' into Chrome trace event JSON
+# Deep Shinglot
+#
+# usage: trace2json.py capture.txt [out.json]
+# open the result in chrome://tracing or https://ui.perfetto.dev
+#
+# capture is the raw UART text, lines that are not part of the dump are ignored
+#   N <index> <name>        task names, printed before the dump
+#   E <cycles> <info>       hex, info = type(31:24) task(23:16) data(15:0)
+
+import json
+import sys
+
+CLOCK_MHZ = 40                  # DWT_CYCCNT runs at the system clock
+
+# must match trace.h
+TRACE_SWITCH, TRACE_SVC, TRACE_WAKE, TRACE_BLOCK = 1, 2, 3, 4
+TRACE_ISR_ENTER, TRACE_ISR_EXIT, TRACE_MALLOC, TRACE_FREE = 5, 6, 7, 8
+
+# must match kernel.c
+STATES = ["INVALID", "STOPPED", "READY", "DELAYED", "BLOCKED_MUTEX",
+          "BLOCKED_SEMAPHORE", "BLOCKED_FLAGS", "BLOCKED_NOTIFY",
+          "BLOCKED_QUEUE", "BLOCKED_MEMORY"]
+SVCS = ["START", "YIELD", "SLEEP", "LOCK", "UNLOCK", "WAIT", "POST",
+        "MALLOC", "IPCS", "KILL", "PKILL", "PIDOF", "SCHED", "PREEMPT", "PI",
+        "MEMINFO", "REBOOT", "RESTART", "NAME_R", "SET_PRI", "PS",
+        "SETFLAGS", "WAITFLAGS", "NOTIFY", "NOTIFY_WAIT", "Q_SEND", "Q_RECV",
+        "LATENCY", "IRQSTAT", "WORK_FETCH", "TRACE", "PROF", "AUTORESTART",
+        "CRASH", "SUBHEAP_INIT", "POOL_CREATE", "POOL_ALLOC", "POOL_FREE",
+        "FREE", "REALLOC", "SHARE_CREATE", "SHARE_GRANT", "SHARE_OPEN",
+        "MALLOC_WAIT", "MEM_PRESSURE", "OOM", "SHARE_DESTROY"]
+
+PID = 1
+ISR_TID = 100                   # isrs get their own row below the tasks
+
+
+def name_of(table, index):
+    return table[index] if index < len(table) else str(index)
+
+
+def describe(kind, data):
+    if kind == TRACE_SVC:
+        return "svc " + name_of(SVCS, data)
+    if kind == TRACE_WAKE:
+        return "wake from " + name_of(STATES, data)
+    if kind == TRACE_BLOCK:
+        return "block " + name_of(STATES, data)
+    if kind == TRACE_MALLOC:
+        return "malloc %d" % data
+    if kind == TRACE_FREE:
+        return "free 0x2000%04X" % data
+    if kind == TRACE_SWITCH:
+        return "switch from %d" % data
+    if kind == TRACE_ISR_ENTER:
+        return "isr enter vector %d" % data
+    if kind == TRACE_ISR_EXIT:
+        return "isr exit"
+    return "event %d" % kind
+
+
+def parse(lines):
+    names = {}
+    events = []
+    for line in lines:
+        fields = line.split()
+        if len(fields) >= 3 and fields[0] == "N":
+            names[int(fields[1])] = " ".join(fields[2:])
+        elif len(fields) == 3 and fields[0] == "E":
+            try:
+                events.append((int(fields[1], 16), int(fields[2], 16)))
+            except ValueError:
+                pass
+    return names, events
+
+
+def convert(names, events):
+    out = []
+    for task, name in names.items():
+        out.append({"ph": "M", "pid": PID, "tid": task, "name": "thread_name",
+                    "args": {"name": name}})
+    out.append({"ph": "M", "pid": PID, "tid": ISR_TID, "name": "thread_name",
+                "args": {"name": "ISR"}})
+
+    # CYCCNT is 32 bit, unwrap it so the timeline keeps going forward
+    base = 0
+    last = None
+    running = None
+    for cycles, info in events:
+        if last is not None and cycles < last:
+            base += 1 << 32
+        last = cycles
+        ts = (base + cycles) / CLOCK_MHZ
+        kind = info >> 24
+        task = (info >> 16) & 0xFF
+        data = info & 0xFFFF
+
+        if kind == TRACE_SWITCH:
+            if running is not None:
+                out.append({"ph": "E", "pid": PID, "tid": running, "ts": ts})
+            out.append({"ph": "B", "pid": PID, "tid": task, "ts": ts,
+                        "name": names.get(task, str(task))})
+            running = task
+        elif kind == TRACE_ISR_ENTER:
+            out.append({"ph": "B", "pid": PID, "tid": ISR_TID, "ts": ts,
+                        "name": "vector %d" % data})
+        elif kind == TRACE_ISR_EXIT:
+            out.append({"ph": "E", "pid": PID, "tid": ISR_TID, "ts": ts})
+        else:
+            out.append({"ph": "i", "s": "t", "pid": PID, "tid": task,
+                        "ts": ts, "name": describe(kind, data)})
+
+    if running is not None and last is not None:
+        out.append({"ph": "E", "pid": PID, "tid": running,
+                    "ts": (base + last) / CLOCK_MHZ})
+    return {"traceEvents": out, "displayTimeUnit": "ns"}
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: trace2json.py capture.txt [out.json]")
+        return 1
+    with open(sys.argv[1], errors="replace") as f:
+        names, events = parse(f)
+    if not events:
+        print("no trace events found")
+        return 1
+    result = json.dumps(convert(names, events), indent=1)
+    if len(sys.argv) > 2:
+        with open(sys.argv[2], "w") as f:
+            f.write(result)
+    else:
+        print(result)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,97 @@
+// Kernel trace functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "trace.h"
+#include "kernel.h"
+#include "mm.h"
+#include "dwt.h"
+
+// flight recorder, oldest events are overwritten once the ring is full
+TRACE_EVENT* traceBuffer = 0;
+uint32_t traceHead = 0;            // events recorded since start, never wraps the mask
+uint32_t traceCursor = 0;          // next event traceRead copies out
+bool traceOn = false;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// kernel aware isrs nest, so the slot is claimed with them masked
+void traceEvent(uint8_t type, uint8_t task, uint16_t data)
+{
+    uint32_t basepri;
+    TRACE_EVENT* event;
+    if (!traceOn)
+        return;
+    basepri = enterCritical();
+    event = &traceBuffer[traceHead++ & (TRACE_EVENTS - 1)];
+    event->cycles = DWT_CYCCNT_R;
+    event->info = ((uint32_t)type << 24) | ((uint32_t)task << 16) | data;
+    leaveCritical(basepri);
+}
+
+// buffer taken from the heap on first start and kept, kernel 4KB is too small
+bool traceStart(void)
+{
+    if (traceBuffer == 0)
+        traceBuffer = mallocFromHeap(TRACE_EVENTS * sizeof(TRACE_EVENT));
+    if (traceBuffer == 0)
+        return false;
+    traceHead = 0;
+    traceOn = true;
+    return true;
+}
+
+void traceStop(void)
+{
+    traceOn = false;
+}
+
+// newest events oldest first, for the crash record, the ring is left as is
+uint8_t traceLast(TRACE_EVENT events[], uint8_t max)
+{
+    uint32_t i, first;
+    if (traceBuffer == 0)
+        return 0;
+    first = (traceHead > max) ? traceHead - max : 0;
+    if (traceHead - first > TRACE_EVENTS)
+        first = traceHead - TRACE_EVENTS;
+    for (i = first; i < traceHead; i++)
+        events[i - first] = traceBuffer[i & (TRACE_EVENTS - 1)];
+    return traceHead - first;
+}
+
+// stops the trace and points the read at the oldest event still in the ring,
+// returns the events recorded since start, 0 if there are none
+uint32_t traceRewind(void)
+{
+    traceOn = false;
+    if (traceBuffer == 0)
+        return 0;
+    traceCursor = (traceHead > TRACE_EVENTS) ? traceHead - TRACE_EVENTS : 0;
+    return traceHead;
+}
+
+// next events oldest first, 0 once the read has reached the newest
+uint32_t traceRead(TRACE_EVENT events[], uint32_t max)
+{
+    uint32_t i;
+    if (traceBuffer == 0)
+        return 0;
+    for (i = 0; i < max && traceCursor < traceHead; i++, traceCursor++)
+        events[i] = traceBuffer[traceCursor & (TRACE_EVENTS - 1)];
+    return i;
+}
@@ -0,0 +1,63 @@
+// Kernel trace functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//-----------------------------------------------------------------------------
+// Trace ring
+//-----------------------------------------------------------------------------
+
+#define TRACE_EVENTS 256               // power of two, 8 B each, taken from the heap
+
+// event types, task is the running task unless noted
+#define TRACE_SWITCH    1              // task switched in, data = task switched out
+#define TRACE_SVC       2              // data = svc number
+#define TRACE_WAKE      3              // task made ready, data = state it left
+#define TRACE_BLOCK     4              // data = state the task blocked in
+#define TRACE_ISR_ENTER 5              // data = vector, instrumented vectors only
+#define TRACE_ISR_EXIT  6
+#define TRACE_MALLOC    7              // data = bytes
+#define TRACE_FREE      8              // data = low half of the address
+
+// shell commands, passed in r0 of the trace svc, the dump is copied out in
+// chunks and printed by the shell so the svc never holds off systick for long
+#define TRACE_STOP  0
+#define TRACE_START 1
+#define TRACE_DUMP  2              // stops and rewinds the read, returns events recorded
+#define TRACE_READ  3              // r1 event buffer, r2 count, returns events copied
+#define TRACE_NAME  4              // r1 name buffer, r2 task, false past the last task
+#define TRACE_CHUNK 16             // events the shell reads per svc
+
+// info packs type (31:24), task (23:16) and data (15:0)
+typedef struct _TRACE_EVENT
+{
+    uint32_t cycles;               // DWT_CYCCNT
+    uint32_t info;
+} TRACE_EVENT;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// privileged, returns at once while tracing is off
+void traceEvent(uint8_t type, uint8_t task, uint16_t data);
+
+// kernel side, called from the svc
+bool traceStart(void);
+void traceStop(void);
+uint32_t traceRewind(void);
+uint32_t traceRead(TRACE_EVENT events[], uint32_t max);
+uint8_t traceLast(TRACE_EVENT events[], uint8_t max);
+
+#endif
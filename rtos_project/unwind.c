@@ -0,0 +1,61 @@
+// Stack unwinder functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "unwind.h"
+#include "heapplan.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+bool isCodeAddress(uint32_t address)
+{
+    return (address & 1) && ((address & ~1) >= CODE_START + 4) && ((address & ~1) < CODE_END);
+}
+
+// a return address follows a BL (32 bit) or BLX Rm (16 bit), anything else
+// found on the stack is a data word that only looks like code
+bool isCallSite(uint32_t ret)
+{
+    uint16_t* after = (uint16_t*)(ret & ~1);
+    uint16_t hw1 = after[-2];
+    uint16_t hw2 = after[-1];
+    if (((hw1 & 0xF800) == 0xF000) && ((hw2 & 0xD000) == 0xD000))
+        return true;                        // BL imm
+    return (hw2 & 0xFF87) == 0x4780;        // BLX Rm
+}
+
+// there is no frame pointer and no unwind table on the target, so the stack
+// is scanned from sp to top for words that are return addresses, stale ones
+// left by finished calls can show up too, pc and lr from the exception frame
+// come first (pc 0 if there is no frame), returns the count
+uint8_t unwindStack(uint32_t pc, uint32_t lr, uint32_t sp, uint32_t top, uint32_t trace[], uint8_t max)
+{
+    uint8_t count = 0;
+    uint32_t* p;
+    if (count < max && pc)
+        trace[count++] = pc;
+    if (count < max && isCodeAddress(lr) && isCallSite(lr))
+        trace[count++] = lr;
+    if (sp & 3 || sp < SRAM_ADDRESS || top > SRAM_END || sp >= top)
+        return count;
+    for (p = (uint32_t*)sp; p < (uint32_t*)top && count < max; p++)
+    {
+        if (isCodeAddress(*p) && isCallSite(*p) && (count == 0 || *p != trace[count - 1]))
+            trace[count++] = *p;
+    }
+    return count;
+}
@@ -0,0 +1,32 @@
+// Stack unwinder functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef UNWIND_H_
+#define UNWIND_H_
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+// Unwinder
+//-----------------------------------------------------------------------------
+
+// code lives in flash after the vector table
+#define CODE_START 0x0000026C
+#define CODE_END   0x00040000
+
+#define UNWIND_DEPTH 8                 // return addresses kept per backtrace
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint8_t unwindStack(uint32_t pc, uint32_t lr, uint32_t sp, uint32_t top, uint32_t trace[], uint8_t max);
+
+#endif
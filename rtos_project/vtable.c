@@ -0,0 +1,175 @@
+// Vector table functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "vtable.h"
+#include "nvic.h"
+#include "dwt.h"
+#include "kdata.h"
+#include "trace.h"
+#include "asm_src.h"
+#include "uart0.h"
+#include "c_fnc.h"
+
+// boot table in flash, see tm4c123gh6pm_startup_ccs.c
+extern void (* const g_pfnVectors[])(void);
+
+// VTOR needs the table aligned to its size rounded up to a power of two,
+// 155 words -> 1KB, .vtable is placed at 0x20000000 by the linker command file
+#pragma DATA_SECTION(vectorTable, ".vtable")
+#pragma DATA_ALIGN(vectorTable, 1024)
+_isr vectorTable[NUM_VECTORS];
+
+typedef struct _IRQ_STAT
+{
+    uint8_t  vector;               // 0 if slot is free
+    _isr     handler;              // isr called by the wrapper
+    uint32_t count;                // entries since last reset
+    uint32_t maxCycles;            // longest single run
+    uint64_t totalCycles;          // includes time in nested higher priority isrs
+} IRQ_STAT;
+
+IRQ_STAT irqStat[MAX_IRQ_STATS];
+uint64_t irqStatStartTick;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// copies the flash table and moves VTOR, core exceptions keep their handlers
+void initVectorTable(void)
+{
+    uint8_t i;
+    for (i = 0; i < NUM_VECTORS; i++)
+        vectorTable[i] = g_pfnVectors[i];
+    for (i = 0; i < MAX_IRQ_STATS; i++)
+        irqStat[i].vector = 0;
+    initCycleCounter();
+    resetIrqStats();
+    irqStatStartTick = 0;           // runs before initKdata clears the tick, which counts from 0
+    __asm(" DSB");
+    NVIC_VTABLE_R = (uint32_t)vectorTable;
+    __asm(" DSB");
+    __asm(" ISB");
+}
+
+// one wrapper for every instrumented vector, IPSR tells which one fired
+static void irqDispatcher(void)
+{
+    uint8_t vector = getIpsr();
+    uint8_t i;
+    uint32_t start, cycles;
+    for (i = 0; i < MAX_IRQ_STATS; i++)
+    {
+        if (irqStat[i].vector == vector)
+        {
+            traceEvent(TRACE_ISR_ENTER, kdata.taskCurrent, vector);
+            start = DWT_CYCCNT_R;
+            irqStat[i].handler();
+            cycles = DWT_CYCCNT_R - start;
+            traceEvent(TRACE_ISR_EXIT, kdata.taskCurrent, vector);
+            irqStat[i].count++;
+            irqStat[i].totalCycles += cycles;
+            if (cycles > irqStat[i].maxCycles)
+                irqStat[i].maxCycles = cycles;
+            return;
+        }
+    }
+}
+
+// device interrupts only (16 and up), the kernel owns the core exceptions
+// instrument routes the vector through irqDispatcher, false if no slot is free
+// caller still enables the interrupt in the NVIC
+bool attachIsr(uint8_t vector, _isr isr, bool instrument)
+{
+    uint8_t i;
+    if (vector < 16 || vector >= NUM_VECTORS || isr == 0)
+        return false;
+    detachIsr(vector);
+    if (!instrument)
+    {
+        vectorTable[vector] = isr;
+        return true;
+    }
+    for (i = 0; i < MAX_IRQ_STATS; i++)
+    {
+        if (irqStat[i].vector == 0)
+        {
+            irqStat[i].handler = isr;
+            irqStat[i].count = 0;
+            irqStat[i].maxCycles = 0;
+            irqStat[i].totalCycles = 0;
+            irqStat[i].vector = vector;
+            __asm(" DSB");
+            vectorTable[vector] = irqDispatcher;
+            return true;
+        }
+    }
+    vectorTable[vector] = g_pfnVectors[vector];
+    return false;
+}
+
+// disables the interrupt and puts the boot handler back
+void detachIsr(uint8_t vector)
+{
+    uint8_t i;
+    if (vector < 16 || vector >= NUM_VECTORS)
+        return;
+    disableNvicInterrupt(vector);
+    vectorTable[vector] = g_pfnVectors[vector];
+    __asm(" DSB");
+    for (i = 0; i < MAX_IRQ_STATS; i++)
+    {
+        if (irqStat[i].vector == vector)
+            irqStat[i].vector = 0;
+    }
+}
+
+void resetIrqStats(void)
+{
+    uint8_t i;
+    for (i = 0; i < MAX_IRQ_STATS; i++)
+    {
+        irqStat[i].count = 0;
+        irqStat[i].maxCycles = 0;
+        irqStat[i].totalCycles = 0;
+    }
+    irqStatStartTick = kdata.tick;
+}
+
+// load is isr cycles over elapsed cycles since the last reset, in 0.01%
+void printIrqStats(void)
+{
+    char str[12];
+    uint8_t i;
+    uint64_t elapsed = (kdata.tick - irqStatStartTick) * 40000;
+    uint32_t load;
+    putsUart0("VECTOR\tCOUNT     \tAVG CLK\tMAX CLK\tLOAD %\n");
+    putsUart0("------------------------------------------------------\n");
+    for (i = 0; i < MAX_IRQ_STATS; i++)
+    {
+        if (irqStat[i].vector == 0)
+            continue;
+        load = elapsed ? (uint32_t)(irqStat[i].totalCycles * 10000 / elapsed) : 0;
+        putsUart0(numToStr(irqStat[i].vector, str)); putcUart0('\t');
+        putsUart0(numToStr(irqStat[i].count, str)); putsUart0("     \t");
+        putsUart0(numToStr(irqStat[i].count ? (uint32_t)(irqStat[i].totalCycles / irqStat[i].count) : 0, str)); putcUart0('\t');
+        putsUart0(numToStr(irqStat[i].maxCycles, str)); putcUart0('\t');
+        putsUart0(numToStr(load / 100, str)); putcUart0('.');
+        if (load % 100 < 10) putcUart0('0');
+        putsUart0(numToStr(load % 100, str)); putcUart0('\n');
+    }
+}
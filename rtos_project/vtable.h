@@ -0,0 +1,42 @@
+// Vector table functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef VTABLE_H_
+#define VTABLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//-----------------------------------------------------------------------------
+// Vector table
+//-----------------------------------------------------------------------------
+
+// entries in g_pfnVectors, 16 core exceptions followed by the device interrupts
+#define NUM_VECTORS 155
+
+// vectors that can go through the counting wrapper at the same time
+#define MAX_IRQ_STATS 4
+
+typedef void (*_isr)(void);
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// privileged only, call from main before startRtos
+void initVectorTable(void);
+bool attachIsr(uint8_t vector, _isr isr, bool instrument);
+void detachIsr(uint8_t vector);
+
+// kernel side, called from the svc
+void resetIrqStats(void);
+void printIrqStats(void);
+
+#endif
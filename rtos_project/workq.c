@@ -0,0 +1,86 @@
+// Deferred work queue functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "workq.h"
+#include "ringbuf.h"
+#include "kernel.h"
+#include "asm_src.h"
+
+// ring lives in kernel memory, the worker only reaches it through the svc
+RING workRing;
+WORK_ITEM workStorage[MAX_WORK_ITEMS];
+uint32_t workDropped;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// worker sleeps on workReady, the ring posts it when it stops being empty
+void initWorkQueue(void)
+{
+    ringInit(&workRing, workStorage, MAX_WORK_ITEMS, sizeof(WORK_ITEM));
+    ringSetWakeHook(&workRing, postFromIsr, workReady);
+    workDropped = 0;
+}
+
+// several isrs can be producers, so the put runs with kernel isrs masked,
+// the svc consumer already runs above them
+bool queueWorkFromIsr(_work fn, uint32_t arg)
+{
+    WORK_ITEM item;
+    uint32_t basepri;
+    bool ok;
+    item.fn = fn;
+    item.arg = arg;
+    basepri = enterCritical();
+    ok = ringPutRecord(&workRing, &item);
+    if (!ok)
+        workDropped++;
+    leaveCritical(basepri);
+    return ok;
+}
+
+uint32_t takeWork(WORK_ITEM items[], uint32_t max)
+{
+    uint32_t count = 0;
+    while (count < max && ringGetRecord(&workRing, &items[count]))
+        count++;
+    return count;
+}
+
+static uint32_t fetchWork(WORK_ITEM items[], uint32_t max)
+{
+    __asm(" SVC #29");
+    return reg0();
+}
+
+// drains in batches until empty, then blocks, a wake with nothing queued
+// just goes around once more
+void worker(void)
+{
+    WORK_ITEM items[WORK_BATCH];
+    uint32_t count, i;
+    while(true)
+    {
+        wait(workReady);
+        do
+        {
+            count = fetchWork(items, WORK_BATCH);
+            for (i = 0; i < count; i++)
+                items[i].fn(items[i].arg);
+        } while (count == WORK_BATCH);
+    }
+}
@@ -0,0 +1,50 @@
+// Deferred work queue functions
+// Deep Shinglot
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+#ifndef WORKQ_H_
+#define WORKQ_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//-----------------------------------------------------------------------------
+// Work queue
+//-----------------------------------------------------------------------------
+
+#define MAX_WORK_ITEMS 16              // power of two
+#define WORK_BATCH 4                   // items the worker takes per service call
+#define WORKER_PRIORITY 6              // createThread priority of the worker task
+
+// work runs later in the worker task, unprivileged, so it may touch
+// peripherals and the worker's own memory but not kernel data
+typedef void (*_work)(uint32_t arg);
+
+typedef struct _WORK_ITEM
+{
+    _work    fn;
+    uint32_t arg;
+} WORK_ITEM;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initWorkQueue(void);
+
+// handler mode, only from interrupts at KERNEL_INT_PRIORITY or lower
+bool queueWorkFromIsr(_work fn, uint32_t arg);
+
+// kernel side, called from the svc
+uint32_t takeWork(WORK_ITEM items[], uint32_t max);
+
+// worker task, create with WORKER_PRIORITY
+void worker(void);
+
+#endif